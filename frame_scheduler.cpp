@@ -0,0 +1,119 @@
+#include "frame_scheduler.h"
+
+#include <algorithm>
+#include <thread>
+
+void frame_scheduler_t::set_target_fps(unsigned fps)
+{
+	this->fps = fps;
+	next_slot = {};
+}
+
+bool frame_scheduler_t::needs_frame(const globe_pose_t& pose, bool animated)
+{
+	if (!animated && has_pose && pose == last_pose) {
+		return false;
+	}
+
+	has_pose = true;
+	last_pose = pose;
+	return true;
+}
+
+void frame_scheduler_t::wait_for_frame_slot()
+{
+	if (fps == 0) {
+		return;
+	}
+
+	const auto period = std::chrono::duration_cast<clock::duration>(std::chrono::seconds(1)) / fps;
+	const auto now = clock::now();
+
+	if (next_slot == clock::time_point{}) {
+		// first frame after start or idle
+		next_slot = now;
+	} else if (now > next_slot + period) {
+		// too far behind to catch up, start over instead of bursting
+		++counters.late_frames;
+		next_slot = now;
+	}
+
+	// the OS sleep is only good to a millisecond or so, spin for the rest
+	constexpr auto SPIN = std::chrono::milliseconds(1);
+	if (next_slot - now > SPIN) {
+		std::this_thread::sleep_until(next_slot - SPIN);
+	}
+	while (clock::now() < next_slot) {
+		std::this_thread::yield();
+	}
+
+	next_slot += period;
+}
+
+uint64_t frame_scheduler_t::issue_frame()
+{
+	++counters.frames;
+	return ++sequence;
+}
+
+void frame_scheduler_t::going_idle()
+{
+	++counters.idle_waits;
+	pending_inputs.clear();
+	next_slot = {};
+}
+
+void frame_scheduler_t::input_event(clock::time_point when)
+{
+	pending_inputs.push_back({ when, sequence + 1 });
+}
+
+void frame_scheduler_t::frame_presented(uint64_t sequence, clock::time_point when)
+{
+	auto shown = std::remove_if(pending_inputs.begin(), pending_inputs.end(), [&](const pending_input_t& input) {
+		if (input.first_sequence > sequence) {
+			return false;
+		}
+
+		add_latency_sample(when - input.when);
+		return true;
+	});
+	pending_inputs.erase(shown, pending_inputs.end());
+}
+
+void frame_scheduler_t::input_presented(clock::time_point input, clock::time_point when)
+{
+	add_latency_sample(when - input);
+}
+
+void frame_scheduler_t::add_latency_sample(clock::duration latency)
+{
+	const auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+	const uint32_t sample = uint32_t(std::max<decltype(us)>(us, 0));
+	if (latency_samples.size() < LATENCY_SAMPLE_COUNT) {
+		latency_samples.push_back(sample);
+	} else {
+		latency_samples[next_latency_sample] = sample;
+		next_latency_sample = (next_latency_sample + 1) % LATENCY_SAMPLE_COUNT;
+	}
+}
+
+frame_scheduler_t::latency_t frame_scheduler_t::latency() const
+{
+	latency_t latency{};
+	latency.samples = latency_samples.size();
+	if (latency_samples.empty()) {
+		return latency;
+	}
+
+	std::vector<uint32_t> sorted = latency_samples;
+	std::sort(sorted.begin(), sorted.end());
+
+	auto percentile = [&](size_t p) {
+		return sorted[((sorted.size() - 1) * p + 99) / 100] / 1000.0;
+	};
+	latency.p50_ms = percentile(50);
+	latency.p99_ms = percentile(99);
+	latency.max_ms = sorted.back() / 1000.0;
+	return latency;
+}
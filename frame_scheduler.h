@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "globe_renderer.h"
+
+/*
+ *  Decides when the viewer draws: only when the canonical pose changed (or every frame
+ *  while animating), optionally paced to a target frame rate. Otherwise the caller
+ *  blocks on its event source instead of spinning.
+ *  Also measures input-to-photon latency: an input event is closed by the first
+ *  present of a pose that was issued after the event, or dropped if nothing had to be
+ *  drawn for it.
+ *  No SDL dependency, the caller does the waiting and flipping.
+ */
+class frame_scheduler_t
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	struct latency_t
+	{
+		size_t samples;
+		double p50_ms;
+		double p99_ms;
+		double max_ms;
+	};
+
+	struct stats_t
+	{
+		uint64_t frames;      // poses issued
+		uint64_t idle_waits;  // times the loop went to sleep until the next event
+		uint64_t late_frames; // paced frames that started more than a frame period late
+	};
+
+	// 0: no pacing, draw as soon as there is something to draw
+	void set_target_fps(unsigned fps);
+	unsigned target_fps() const { return fps; }
+
+	// true: the pose has to be drawn. Keeps the pose it was asked about
+	bool needs_frame(const globe_pose_t& pose, bool animated);
+	// the next needs_frame() is true even for the same pose, e.g. after the map changed
+	void redraw() { has_pose = false; }
+
+	// sleeps until the next frame slot, does nothing without a target frame rate
+	void wait_for_frame_slot();
+
+	// the caller draws (or requests) a pose, returns its sequence number (1, 2, ...)
+	uint64_t issue_frame();
+	// the loop goes to sleep: input that is still waiting did not need a frame
+	void going_idle();
+
+	// an input event was taken from the queue
+	void input_event(clock::time_point when = clock::now());
+	// the frame of the given sequence number (or a newer one) reached the screen
+	void frame_presented(uint64_t sequence, clock::time_point when = clock::now());
+	// an input that was handled without a new pose (e.g. a palette change) reached the screen
+	void input_presented(clock::time_point input, clock::time_point when = clock::now());
+
+	latency_t latency() const;
+	const stats_t& stats() const { return counters; }
+
+private:
+	void add_latency_sample(clock::duration latency);
+
+	struct pending_input_t
+	{
+		clock::time_point when;
+		uint64_t first_sequence; // the first frame that can show the input
+	};
+
+	unsigned fps = 0;
+	clock::time_point next_slot{};
+
+	bool has_pose = false;
+	globe_pose_t last_pose{};
+
+	uint64_t sequence = 0;
+	std::vector<pending_input_t> pending_inputs;
+
+	// the newest LATENCY_SAMPLE_COUNT latencies in microseconds, a ring once full
+	static constexpr size_t LATENCY_SAMPLE_COUNT = 4096;
+	std::vector<uint32_t> latency_samples;
+	size_t next_latency_sample = 0;
+
+	stats_t counters{};
+};
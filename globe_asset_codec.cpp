@@ -0,0 +1,301 @@
+#include "globe_asset_codec.h"
+#include "globe_renderer.h"
+
+#include <memory>
+
+namespace {
+
+// 11 bit probabilities of a 0 bit, adapting by 1/32 of the distance per bit
+constexpr int PROBABILITY_BITS = 11;
+constexpr int ADAPTATION_SHIFT = 5;
+constexpr uint16_t PROBABILITY_HALF = 1 << (PROBABILITY_BITS - 1);
+constexpr uint32_t RANGE_TOP = 1u << 24;
+
+constexpr int MIN_MATCH = 3;
+constexpr int MIN_REPEAT = 2;
+constexpr int MAX_NUMBER_BITS = 24;
+
+enum number_kind_t { LENGTH, DISTANCE };
+
+struct model_t
+{
+	// contexts: 1 after a match, 0 after a literal
+	uint16_t is_match[2];
+	uint16_t is_repeat[2];
+	uint16_t literal[256]; // bit tree, node 1 is the top bit
+	// numbers >= 1: the bit count unary, then the bits below the top one
+	uint16_t number_bit_count[2][MAX_NUMBER_BITS + 1];
+	uint16_t number_bits[2][MAX_NUMBER_BITS + 1][MAX_NUMBER_BITS];
+
+	model_t()
+	{
+		uint16_t* probabilities = &is_match[0];
+		for (size_t i = 0; i != sizeof(model_t) / sizeof(uint16_t); ++i) {
+			probabilities[i] = PROBABILITY_HALF;
+		}
+	}
+};
+
+class range_encoder_t
+{
+public:
+	void encode(uint16_t& probability, int bit)
+	{
+		const uint32_t bound = (range >> PROBABILITY_BITS) * probability;
+		if (bit == 0) {
+			range = bound;
+			probability += ((1 << PROBABILITY_BITS) - probability) >> ADAPTATION_SHIFT;
+		} else {
+			low += bound;
+			range -= bound;
+			probability -= probability >> ADAPTATION_SHIFT;
+		}
+		while (range < RANGE_TOP) {
+			range <<= 8;
+			shift_low();
+		}
+	}
+
+	void encode_number(model_t& model, number_kind_t kind, uint32_t value)
+	{
+		int bit_count = 0;
+		while ((value >> (bit_count + 1)) != 0) {
+			++bit_count;
+		}
+		for (int i = 0; i != bit_count; ++i) {
+			encode(model.number_bit_count[kind][i], 1);
+		}
+		if (bit_count != MAX_NUMBER_BITS) {
+			encode(model.number_bit_count[kind][bit_count], 0);
+		}
+		for (int i = bit_count - 1; i >= 0; --i) {
+			encode(model.number_bits[kind][bit_count][i], (value >> i) & 1);
+		}
+	}
+
+	std::vector<uint8_t> finish()
+	{
+		for (int i = 0; i != 5; ++i) {
+			shift_low();
+		}
+		return std::move(out);
+	}
+
+private:
+	// the top byte of low is held back in cache until it is clear that no carry reaches it
+	void shift_low()
+	{
+		if (uint32_t(low) < 0xff000000u || (low >> 32) != 0) {
+			const uint8_t carry = uint8_t(low >> 32);
+			uint8_t byte = cache;
+			do {
+				out.push_back(uint8_t(byte + carry));
+				byte = 0xff;
+			} while (--cache_size != 0);
+			cache = uint8_t(low >> 24);
+		}
+		++cache_size;
+		low = (low & 0x00ffffff) << 8;
+	}
+
+	uint64_t low = 0;
+	uint32_t range = 0xffffffff;
+	uint8_t cache = 0;
+	uint64_t cache_size = 1;
+	std::vector<uint8_t> out;
+};
+
+class range_decoder_t
+{
+public:
+	range_decoder_t(const uint8_t* packed, size_t packed_size)
+		: src(packed)
+		, src_end(packed + packed_size)
+	{
+		for (int i = 0; i != 5; ++i) {
+			code = (code << 8) | next_byte();
+		}
+	}
+
+	int decode(uint16_t& probability)
+	{
+		const uint32_t bound = (range >> PROBABILITY_BITS) * probability;
+		int bit;
+		if (code < bound) {
+			range = bound;
+			probability += ((1 << PROBABILITY_BITS) - probability) >> ADAPTATION_SHIFT;
+			bit = 0;
+		} else {
+			code -= bound;
+			range -= bound;
+			probability -= probability >> ADAPTATION_SHIFT;
+			bit = 1;
+		}
+		while (range < RANGE_TOP) {
+			range <<= 8;
+			code = (code << 8) | next_byte();
+		}
+		return bit;
+	}
+
+	uint32_t decode_number(model_t& model, number_kind_t kind)
+	{
+		int bit_count = 0;
+		while (bit_count != MAX_NUMBER_BITS && decode(model.number_bit_count[kind][bit_count])) {
+			++bit_count;
+		}
+		uint32_t value = 1;
+		for (int i = bit_count - 1; i >= 0; --i) {
+			value = (value << 1) | uint32_t(decode(model.number_bits[kind][bit_count][i]));
+		}
+		return value;
+	}
+
+	// the encoder flushes everything it wrote, reading past it means the data is broken
+	bool overrun() const { return overrun_count != 0; }
+
+private:
+	uint8_t next_byte()
+	{
+		if (src == src_end) {
+			++overrun_count;
+			return 0;
+		}
+		return *src++;
+	}
+
+	const uint8_t* src;
+	const uint8_t* const src_end;
+	uint32_t range = 0xffffffff;
+	uint32_t code = 0;
+	int overrun_count = 0;
+};
+
+} // namespace
+
+std::vector<uint8_t> pack_assets(const uint8_t* data, size_t size)
+{
+	constexpr int HASH_BITS = 16;
+	constexpr int MAX_CHAIN = 4096;
+	constexpr size_t MAX_DISTANCE = 1 << 18;
+
+	// positions by their first 3 bytes, newest first
+	std::vector<int> head(size_t(1) << HASH_BITS, -1);
+	std::vector<int> chain(size, -1);
+	const auto hash = [&](size_t i) {
+		return ((data[i] * 506832829u) ^ (data[i + 1] * 2654435761u) ^ (data[i + 2] * 40503u)) >> (32 - HASH_BITS);
+	};
+	const auto insert = [&](size_t i) {
+		if (i + MIN_MATCH <= size) {
+			const uint32_t h = hash(i);
+			chain[i] = head[h];
+			head[h] = int(i);
+		}
+	};
+
+	std::unique_ptr<model_t> model(new model_t());
+	range_encoder_t encoder;
+
+	int after_match = 0;
+	size_t repeat_distance = 1;
+	size_t i = 0;
+	while (i < size) {
+		size_t repeat_length = 0;
+		if (i >= repeat_distance) {
+			while (i + repeat_length < size && data[i + repeat_length] == data[i + repeat_length - repeat_distance]) {
+				++repeat_length;
+			}
+		}
+
+		size_t match_length = 0;
+		size_t match_distance = 0;
+		if (i + MIN_MATCH <= size) {
+			int candidate = head[hash(i)];
+			for (int depth = 0; candidate >= 0 && depth != MAX_CHAIN && i - candidate <= MAX_DISTANCE; ++depth) {
+				size_t length = 0;
+				while (i + length < size && data[candidate + length] == data[i + length]) {
+					++length;
+				}
+				if (length > match_length) {
+					match_length = length;
+					match_distance = i - candidate;
+				}
+				candidate = chain[candidate];
+			}
+		}
+
+		size_t advance;
+		// the repeat costs no distance, it wins unless the match is clearly longer
+		if (repeat_length >= MIN_REPEAT && repeat_length + 2 >= match_length) {
+			encoder.encode(model->is_match[after_match], 1);
+			encoder.encode(model->is_repeat[after_match], 1);
+			encoder.encode_number(*model, LENGTH, uint32_t(repeat_length - MIN_REPEAT + 1));
+			advance = repeat_length;
+			after_match = 1;
+		} else if (match_length >= MIN_MATCH) {
+			encoder.encode(model->is_match[after_match], 1);
+			encoder.encode(model->is_repeat[after_match], 0);
+			encoder.encode_number(*model, LENGTH, uint32_t(match_length - MIN_MATCH + 1));
+			encoder.encode_number(*model, DISTANCE, uint32_t(match_distance));
+			repeat_distance = match_distance;
+			advance = match_length;
+			after_match = 1;
+		} else {
+			encoder.encode(model->is_match[after_match], 0);
+			int node = 1;
+			for (int bit = 7; bit >= 0; --bit) {
+				const int b = (data[i] >> bit) & 1;
+				encoder.encode(model->literal[node], b);
+				node = node * 2 + b;
+			}
+			advance = 1;
+			after_match = 0;
+		}
+
+		for (size_t end = i + advance; i != end; ++i) {
+			insert(i);
+		}
+	}
+
+	return encoder.finish();
+}
+
+void unpack_assets(const uint8_t* packed, size_t packed_size, uint8_t* dst, size_t size)
+{
+	std::unique_ptr<model_t> model(new model_t());
+	range_decoder_t decoder(packed, packed_size);
+
+	int after_match = 0;
+	size_t repeat_distance = 1;
+	size_t i = 0;
+	while (i < size) {
+		if (!decoder.decode(model->is_match[after_match])) {
+			int node = 1;
+			while (node < 256) {
+				node = node * 2 + decoder.decode(model->literal[node]);
+			}
+			dst[i++] = uint8_t(node);
+			after_match = 0;
+			continue;
+		}
+
+		size_t length;
+		if (decoder.decode(model->is_repeat[after_match])) {
+			length = decoder.decode_number(*model, LENGTH) + MIN_REPEAT - 1;
+		} else {
+			length = decoder.decode_number(*model, LENGTH) + MIN_MATCH - 1;
+			repeat_distance = decoder.decode_number(*model, DISTANCE);
+		}
+		assert_throw(repeat_distance <= i && length <= size - i);
+
+		// byte by byte, a match may overlap the bytes it writes
+		const uint8_t* from = &dst[i - repeat_distance];
+		for (size_t k = 0; k != length; ++k) {
+			dst[i + k] = from[k];
+		}
+		i += length;
+		after_match = 1;
+	}
+
+	assert_throw(!decoder.overrun());
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ *  The codec of the compressed asset build (GLOBE_COMPRESSED_ASSETS), no library needed:
+ *  LZ77 (matches up to 256 KB back, plus a repeat of the last match distance) with every
+ *  decision, literal bit and length/distance bit coded by an adaptive binary range coder.
+ *  The assets pack to ~27% of their size, unpacking all of them takes a few ms.
+ */
+
+// slow (a deep match search), for globe_pack only
+std::vector<uint8_t> pack_assets(const uint8_t* data, size_t size);
+
+// size: the unpacked size, throws if packed does not unpack to exactly that
+void unpack_assets(const uint8_t* packed, size_t packed_size, uint8_t* dst, size_t size);
@@ -0,0 +1,232 @@
+#include "globe_assets.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef GLOBE_COMPRESSED_ASSETS
+#include "globe_asset_codec.h"
+
+// GLOBE_ASSETS_PACK: pack_assets() of the four assets back to back, written by globe_pack
+#include "ASSETS.PACK.inc"
+#else
+#include "GLOBDATA.BIN.inc"
+#include "MAP.BIN.inc"
+#include "PAL.BIN.inc"
+#include "TABLAT.BIN.inc"
+
+static_assert(sizeof(GLOBDATA_BIN) == GLOBDATA_BIN_SIZE, "wrong size");
+static_assert(sizeof(MAP_BIN) == MAP_BIN_SIZE, "wrong size");
+static_assert(sizeof(PAL_BIN) == PAL_BIN_SIZE, "wrong size");
+static_assert(sizeof(TABLAT_BIN) == TABLAT_BIN_SIZE, "wrong size");
+#endif
+
+namespace {
+
+// a read only mapping of a whole file, unmapped on destruction
+class mapped_file_t
+{
+public:
+	mapped_file_t() = default;
+	~mapped_file_t() { unmap(); }
+
+	mapped_file_t(const mapped_file_t&) = delete;
+	mapped_file_t& operator=(const mapped_file_t&) = delete;
+
+	bool map(const std::string& path);
+
+	const uint8_t* data() const { return bytes; }
+	size_t size() const { return byte_count; }
+
+private:
+	void unmap();
+
+	const uint8_t* bytes = nullptr;
+	size_t byte_count = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+};
+
+#ifdef _WIN32
+bool mapped_file_t::map(const std::string& path)
+{
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		return false;
+	}
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		return false;
+	}
+	bytes = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	byte_count = bytes ? size_t(file_size.QuadPart) : 0;
+	return bytes != nullptr;
+}
+
+void mapped_file_t::unmap()
+{
+	if (bytes) UnmapViewOfFile(bytes);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+#else
+bool mapped_file_t::map(const std::string& path)
+{
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	// mmap of 0 bytes fails, the size check reports it
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+	void* p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps the file alive
+	close(fd);
+	if (p == MAP_FAILED) {
+		return false;
+	}
+	bytes = static_cast<const uint8_t*>(p);
+	byte_count = size_t(st.st_size);
+	return true;
+}
+
+void mapped_file_t::unmap()
+{
+	if (bytes) munmap(const_cast<uint8_t*>(bytes), byte_count);
+}
+#endif
+
+struct loaded_assets_t
+{
+	mapped_file_t globdata;
+	mapped_file_t map;
+	mapped_file_t pal;
+	mapped_file_t tablat;
+	globe_assets_t view{};
+};
+
+struct embedded_t
+{
+	globe_embedded_assets_t info;
+	globe_assets_t view;
+};
+
+#ifdef GLOBE_COMPRESSED_ASSETS
+// the one buffer all four are unpacked into
+std::array<uint8_t, GLOBE_ASSETS_SIZE> unpacked_assets;
+
+embedded_t unpack_embedded_assets()
+{
+	const auto start = std::chrono::steady_clock::now();
+	unpack_assets(GLOBE_ASSETS_PACK, sizeof(GLOBE_ASSETS_PACK), unpacked_assets.data(), unpacked_assets.size());
+	const double decode_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	const uint8_t* globdata = unpacked_assets.data();
+	const uint8_t* map = globdata + GLOBDATA_BIN_SIZE;
+	const uint8_t* pal = map + MAP_BIN_SIZE;
+	const uint8_t* tablat = pal + PAL_BIN_SIZE;
+	return { { GLOBE_ASSETS_SIZE, sizeof(GLOBE_ASSETS_PACK), decode_ms }, { globdata, map, pal, tablat, 0 } };
+}
+
+const embedded_t& embedded()
+{
+	static const embedded_t assets = unpack_embedded_assets();
+	return assets;
+}
+#else
+const embedded_t& embedded()
+{
+	static const embedded_t assets{ { GLOBE_ASSETS_SIZE, GLOBE_ASSETS_SIZE, 0.0 }, { GLOBDATA_BIN, MAP_BIN, PAL_BIN, TABLAT_BIN, 0 } };
+	return assets;
+}
+#endif
+
+// nullptr: the embedded assets
+std::atomic<const globe_assets_t*> current_assets{ nullptr };
+
+// every view ever loaded, see load_globe_assets
+std::mutex load_mutex;
+std::vector<std::unique_ptr<loaded_assets_t>> loaded_assets;
+
+bool map_asset(mapped_file_t& file, const std::string& directory, const char* name, size_t size)
+{
+	const std::string path = directory + "/" + name;
+	if (!file.map(path)) {
+		fprintf(stderr, "can't map %s\n", path.c_str());
+		return false;
+	}
+	if (file.size() != size) {
+		fprintf(stderr, "%s has %zu bytes instead of %zu\n", path.c_str(), file.size(), size);
+		return false;
+	}
+	return true;
+}
+
+} // namespace
+
+const globe_assets_t& globe_assets()
+{
+	const globe_assets_t* assets = current_assets.load(std::memory_order_acquire);
+	return assets ? *assets : embedded().view;
+}
+
+const globe_embedded_assets_t& globe_embedded_assets()
+{
+	return embedded().info;
+}
+
+bool load_globe_assets(const char* directory)
+{
+	std::lock_guard<std::mutex> lock(load_mutex);
+
+	auto assets = std::make_unique<loaded_assets_t>();
+	if (!map_asset(assets->globdata, directory, "GLOBDATA.BIN", GLOBDATA_BIN_SIZE) ||
+		!map_asset(assets->map, directory, "MAP.BIN", MAP_BIN_SIZE) ||
+		!map_asset(assets->pal, directory, "PAL.BIN", PAL_BIN_SIZE) ||
+		!map_asset(assets->tablat, directory, "TABLAT.BIN", TABLAT_BIN_SIZE)) {
+		return false;
+	}
+
+	// the globe program and the rotation table are decoded from these at compile time,
+	// and all the unchecked kernels rely on validate_globe_tables() having seen them
+	const globe_assets_t& built_with = embedded().view;
+	if (memcmp(assets->globdata.data(), built_with.globdata, GLOBDATA_BIN_SIZE) != 0) {
+		fprintf(stderr, "%s/GLOBDATA.BIN is not the one the renderer was built with\n", directory);
+		return false;
+	}
+	if (memcmp(assets->tablat.data(), built_with.tablat, TABLAT_BIN_SIZE) != 0) {
+		fprintf(stderr, "%s/TABLAT.BIN is not the one the renderer was built with\n", directory);
+		return false;
+	}
+
+	const unsigned generation = globe_assets().generation + 1;
+	assets->view = { assets->globdata.data(), assets->map.data(), assets->pal.data(), assets->tablat.data(), generation };
+
+	current_assets.store(&assets->view, std::memory_order_release);
+	loaded_assets.push_back(std::move(assets));
+	return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifndef GLOBE_COMPRESSED_ASSETS
+// the embedded assets (xxd -i), defined in globe_assets.cpp.
+// With GLOBE_COMPRESSED_ASSETS only ASSETS.PACK.inc is embedded, see globe_embedded_assets()
+extern unsigned char GLOBDATA_BIN[];
+extern unsigned char MAP_BIN[];
+extern unsigned char PAL_BIN[];
+extern uint8_t TABLAT_BIN[792];
+#endif
+
+constexpr size_t GLOBDATA_BIN_SIZE = 16091; // sizeof(GLOBDATA_BIN_t)
+constexpr size_t MAP_BIN_SIZE = 50681;
+constexpr size_t PAL_BIN_SIZE = 768;        // 256 RGB triples
+constexpr size_t TABLAT_BIN_SIZE = 792;
+constexpr size_t GLOBE_ASSETS_SIZE = GLOBDATA_BIN_SIZE + MAP_BIN_SIZE + PAL_BIN_SIZE + TABLAT_BIN_SIZE;
+
+/*
+ *  GLOBDATA.BIN, MAP.BIN, PAL.BIN and TABLAT.BIN, the one read only copy the
+ *  renderer, initial_port and the viewer all read.
+ *  Starts out as the embedded arrays, load_globe_assets() maps the files of a
+ *  directory instead.
+ */
+struct globe_assets_t
+{
+	const uint8_t* globdata;
+	const uint8_t* map;
+	const uint8_t* pal;
+	const uint8_t* tablat;
+
+	// 0: the embedded assets, every load_globe_assets() counts up.
+	// The renderer drops its cached frames when it changes.
+	unsigned generation;
+};
+
+// the current view, safe to call from any thread
+const globe_assets_t& globe_assets();
+
+struct globe_embedded_assets_t
+{
+	size_t size;        // GLOBE_ASSETS_SIZE
+	size_t stored_size; // in the binary, < size if they are compressed
+	double decode_ms;   // unpacking them at startup, 0 if they are not compressed
+};
+
+// how the assets are embedded. With GLOBE_COMPRESSED_ASSETS they are unpacked into one
+// buffer the first time globe_assets() or this is called
+const globe_embedded_assets_t& globe_embedded_assets();
+
+/*
+ *  mmaps the four files from directory and makes them the current view.
+ *  GLOBDATA.BIN and TABLAT.BIN have to be the ones the renderer tables were
+ *  decoded from at compile time, MAP.BIN and PAL.BIN can be any map and palette
+ *  of the original size.
+ *  false (and the current view stays): a file is missing or does not fit, the
+ *  reason goes to stderr.
+ *  Replaced views stay mapped, a frame another thread is rendering keeps reading
+ *  the view it started with.
+ */
+bool load_globe_assets(const char* directory);
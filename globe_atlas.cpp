@@ -0,0 +1,207 @@
+// Globe sprite atlas generator, no SDL needed:
+//   g++ -O2 -std=c++17 -pthread globe_atlas.cpp globe_batch.cpp globe_assets.cpp globe_renderer.cpp globe_frame_cache.cpp globe_geometry.cpp globe_simd.cpp worker_pool.cpp -o globe_atlas
+//
+//   ./globe_atlas [--tilts T,T,... | --all-tilts] [--rotations N] [--columns N] [--threads N] [--assets DIR] atlas.bmp atlas.txt
+//
+// Renders N rotations (default: one per rotation class, 398; up to 65536, above 398 several
+// share a rotation class and a frame) at every tilt (default: 0) with render_globe_atlas, writes the cells as an 8-bit BMP with the PAL.BIN palette (pixels off the
+// globe are index 0) and the index: one line per cell with the pose and the cell rectangle.
+// Prints the time and the frames/s.
+
+#include "globe_batch.h"
+#include "globe_assets.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct options_t {
+	std::vector<int16_t> tilts;
+	int rotation_count = GLOBE_ROTATION_CLASS_COUNT;
+	int columns = 0;
+	unsigned thread_count = 0;
+	std::string asset_directory;
+	std::string atlas_path;
+	std::string index_path;
+};
+
+bool parse_tilts(const char* text, std::vector<int16_t>& tilts)
+{
+	for (const char* p = text; *p; ) {
+		char* end;
+		const long tilt = strtol(p, &end, 10);
+		if (end == p || tilt < -MAX_TILT || tilt > MAX_TILT) {
+			return false;
+		}
+		if (*end != ',' && *end != 0) {
+			return false;
+		}
+		tilts.push_back(int16_t(tilt));
+		p = (*end == ',') ? end + 1 : end;
+	}
+	return !tilts.empty();
+}
+
+bool parse_options(int argc, char** argv, options_t& options)
+{
+	std::vector<std::string> paths;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool has_value = i + 1 < argc;
+
+		if (arg == "--tilts" && has_value) {
+			if (!parse_tilts(argv[++i], options.tilts)) {
+				return false;
+			}
+		} else if (arg == "--all-tilts") {
+			for (int tilt = -MAX_TILT; tilt <= MAX_TILT; ++tilt) {
+				options.tilts.push_back(int16_t(tilt));
+			}
+		} else if (arg == "--rotations" && has_value) {
+			options.rotation_count = atoi(argv[++i]);
+		} else if (arg == "--columns" && has_value) {
+			options.columns = atoi(argv[++i]);
+		} else if (arg == "--threads" && has_value) {
+			options.thread_count = unsigned(atoi(argv[++i]));
+		} else if (arg == "--assets" && has_value) {
+			options.asset_directory = argv[++i];
+		} else if (arg[0] != '-') {
+			paths.push_back(arg);
+		} else {
+			return false;
+		}
+	}
+
+	if (options.tilts.empty()) {
+		options.tilts.push_back(0);
+	}
+	if (paths.size() != 2) {
+		return false;
+	}
+	options.atlas_path = paths[0];
+	options.index_path = paths[1];
+	return options.rotation_count >= 1 && options.rotation_count <= 0x10000 && options.columns >= 0;
+}
+
+void put_u16(std::vector<uint8_t>& out, uint32_t value)
+{
+	out.push_back(uint8_t(value));
+	out.push_back(uint8_t(value >> 8));
+}
+
+void put_u32(std::vector<uint8_t>& out, uint32_t value)
+{
+	put_u16(out, value & 0xffff);
+	put_u16(out, value >> 16);
+}
+
+// 8 bits per pixel, uncompressed, bottom-up rows padded to 4 bytes
+bool write_bmp(const std::string& path, const globe_atlas_t& atlas, const uint8_t* pal)
+{
+	const uint32_t row_size = (uint32_t(atlas.width) + 3) & ~3u;
+	const uint32_t pixel_offset = 14 + 40 + 256 * 4;
+
+	std::vector<uint8_t> out;
+	out.reserve(pixel_offset + size_t(row_size) * atlas.height);
+
+	out.push_back('B');
+	out.push_back('M');
+	put_u32(out, pixel_offset + row_size * atlas.height);
+	put_u32(out, 0);
+	put_u32(out, pixel_offset);
+
+	put_u32(out, 40);
+	put_u32(out, atlas.width);
+	put_u32(out, atlas.height);
+	put_u16(out, 1); // planes
+	put_u16(out, 8); // bits per pixel
+	put_u32(out, 0); // BI_RGB
+	put_u32(out, row_size * atlas.height);
+	put_u32(out, 2835); // 72 dpi
+	put_u32(out, 2835);
+	put_u32(out, 256);
+	put_u32(out, 0);
+
+	// BGRx
+	for (int i = 0; i != 256; ++i) {
+		out.push_back(pal[i * 3 + 2]);
+		out.push_back(pal[i * 3 + 1]);
+		out.push_back(pal[i * 3 + 0]);
+		out.push_back(0);
+	}
+
+	for (int y = atlas.height - 1; y >= 0; --y) {
+		const uint8_t* row = &atlas.pixels[size_t(y) * atlas.width];
+		out.insert(out.end(), row, row + atlas.width);
+		out.insert(out.end(), row_size - atlas.width, 0);
+	}
+
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file) {
+		fprintf(stderr, "can't write %s\n", path.c_str());
+		return false;
+	}
+	const bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+	if ((fclose(file) != 0) || !ok) {
+		fprintf(stderr, "can't write %s\n", path.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool write_index(const std::string& path, const std::string& atlas_path, const globe_atlas_t& atlas)
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file) {
+		fprintf(stderr, "can't write %s\n", path.c_str());
+		return false;
+	}
+
+	fprintf(file, "# %s: %d x %d, %zu cells of %d x %d in %d columns\n",
+		atlas_path.c_str(), atlas.width, atlas.height, atlas.cells.size(), atlas.cell_width, atlas.cell_height, atlas.columns);
+	fprintf(file, "# cell tilt rotation x y w h\n");
+	for (size_t i = 0; i != atlas.cells.size(); ++i) {
+		const auto& cell = atlas.cells[i];
+		fprintf(file, "%zu %d %u %d %d %d %d\n", i, cell.tilt, cell.rotation, cell.x, cell.y, atlas.cell_width, atlas.cell_height);
+	}
+
+	const bool ok = ferror(file) == 0;
+	if ((fclose(file) != 0) || !ok) {
+		fprintf(stderr, "can't write %s\n", path.c_str());
+		return false;
+	}
+	return true;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	options_t options;
+	if (!parse_options(argc, argv, options)) {
+		fprintf(stderr, "usage: %s [--tilts T,T,... | --all-tilts] [--rotations N] [--columns N] [--threads N] [--assets DIR] atlas.bmp atlas.txt\n", argv[0]);
+		return 1;
+	}
+
+	if (!options.asset_directory.empty() && !load_globe_assets(options.asset_directory.c_str())) {
+		return 1;
+	}
+
+	const std::vector<globe_batch_pose_t> poses = globe_sprite_poses(options.tilts, options.rotation_count);
+
+	globe_batch_stats_t stats{};
+	const globe_atlas_t atlas = render_globe_atlas(poses, options.columns, options.thread_count, &stats);
+
+	printf("%zu frames (%zu rendered, %zu tilts) on %u threads in %.3f s, %.0f frames/s\n",
+		stats.poses, stats.rendered, stats.tilts, stats.thread_count, stats.seconds, stats.frames_per_second);
+
+	if (!write_bmp(options.atlas_path, atlas, globe_assets().pal) || !write_index(options.index_path, options.atlas_path, atlas)) {
+		return 1;
+	}
+	printf("%s: %d x %d, %s\n", options.atlas_path.c_str(), atlas.width, atlas.height, options.index_path.c_str());
+	return 0;
+}
@@ -0,0 +1,173 @@
+#include "globe_batch.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// frames of one tilt a job renders at most, short enough to keep all threads busy
+constexpr int RUN_LENGTH = 32;
+
+// a pose that is drawn, into the cells of the poses sharing its canonical pose
+struct batch_frame_t
+{
+	int pose_index; // globe_pose_index
+	int16_t tilt;
+	uint16_t rotation;
+	size_t cell;    // the first cell, the others copy it
+};
+
+// consecutive frames of one tilt class
+struct batch_run_t
+{
+	size_t first_frame;
+	size_t end_frame;
+};
+
+void copy_cell(globe_atlas_t& atlas, size_t from, size_t to)
+{
+	const auto& src = atlas.cells[from];
+	const auto& dst = atlas.cells[to];
+	for (int y = 0; y != atlas.cell_height; ++y) {
+		memcpy(&atlas.pixels[size_t(dst.y + y) * atlas.width + dst.x], &atlas.pixels[size_t(src.y + y) * atlas.width + src.x], atlas.cell_width);
+	}
+}
+
+}
+
+globe_atlas_t render_globe_atlas(const std::vector<globe_batch_pose_t>& poses, int columns, unsigned thread_count, globe_batch_stats_t* stats)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const framebuffer_rect_t& rect = globe_bounding_rect();
+
+	if (columns <= 0) {
+		columns = std::max(1, int(std::ceil(std::sqrt(double(poses.size())))));
+	}
+	if (thread_count == 0) {
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	globe_atlas_t atlas{};
+	atlas.cell_width = rect.w;
+	atlas.cell_height = rect.h;
+	atlas.columns = columns;
+	atlas.width = columns * rect.w;
+	atlas.height = int((poses.size() + columns - 1) / columns) * rect.h;
+	atlas.pixels.assign(size_t(atlas.width) * atlas.height, 0);
+
+	// one frame per canonical pose, tilt major
+	std::vector<batch_frame_t> frames;
+	std::vector<int> frame_of_pose(GLOBE_POSE_COUNT, -1);
+	std::vector<std::pair<size_t, size_t>> copies; // (from, to) cell
+	for (size_t cell = 0; cell != poses.size(); ++cell) {
+		const globe_batch_pose_t& pose = poses[cell];
+		atlas.cells.push_back({ pose.tilt, pose.rotation, int(cell % columns) * rect.w, int(cell / columns) * rect.h });
+
+		const int pose_index = globe_pose_index(canonical_globe_pose(pose.tilt, pose.rotation));
+		if (frame_of_pose[pose_index] < 0) {
+			frame_of_pose[pose_index] = int(frames.size());
+			frames.push_back({ pose_index, pose.tilt, pose.rotation, cell });
+		} else {
+			copies.push_back({ frames[frame_of_pose[pose_index]].cell, cell });
+		}
+	}
+	std::sort(frames.begin(), frames.end(), [](const batch_frame_t& a, const batch_frame_t& b) { return a.pose_index < b.pose_index; });
+
+	std::vector<batch_run_t> runs;
+	size_t tilt_count = 0;
+	for (size_t first = 0; first != frames.size(); ) {
+		const int tilt_class = frames[first].pose_index / GLOBE_ROTATION_CLASS_COUNT;
+		size_t end = first;
+		while (end != frames.size() && frames[end].pose_index / GLOBE_ROTATION_CLASS_COUNT == tilt_class) {
+			++end;
+		}
+		++tilt_count;
+
+		// split evenly, so no run is much shorter than the others
+		const size_t run_count = (end - first + RUN_LENGTH - 1) / RUN_LENGTH;
+		for (size_t run = 0; run != run_count; ++run) {
+			runs.push_back({ first + (end - first) * run / run_count, first + (end - first) * (run + 1) / run_count });
+		}
+		first = end;
+	}
+
+	// a renderer per thread: its map copies are built on its first frame, its geometry cache
+	// keeps the per pixel geometry of the tilt of a run for the rotations of the run
+	worker_pool_t pool(thread_count);
+	std::vector<std::unique_ptr<globe_renderer_t>> renderers;
+	std::mutex renderers_mutex;
+
+	pool.run(int(runs.size()), [&](int run_index) {
+		const batch_run_t& run = runs[run_index];
+
+		std::unique_ptr<globe_renderer_t> renderer;
+		{
+			std::lock_guard<std::mutex> lock(renderers_mutex);
+			if (!renderers.empty()) {
+				renderer = std::move(renderers.back());
+				renderers.pop_back();
+			}
+		}
+		if (!renderer) {
+			renderer.reset(new globe_renderer_t());
+		}
+
+		// the renderer only ever writes the globe pixels, the rest stays 0
+		std::vector<uint8_t> framebuffer(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT, 0);
+		const uint8_t* globe = &framebuffer[rect.y * FRAMEBUFFER_WIDTH + rect.x];
+
+		for (size_t i = run.first_frame; i != run.end_frame; ++i) {
+			const batch_frame_t& frame = frames[i];
+			renderer->render(frame.tilt, frame.rotation, framebuffer.data());
+
+			// cells of different frames never overlap, no locking
+			const auto& cell = atlas.cells[frame.cell];
+			for (int y = 0; y != rect.h; ++y) {
+				memcpy(&atlas.pixels[size_t(cell.y + y) * atlas.width + cell.x], globe + y * FRAMEBUFFER_WIDTH, rect.w);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(renderers_mutex);
+		renderers.push_back(std::move(renderer));
+	});
+
+	for (const auto& copy : copies) {
+		copy_cell(atlas, copy.first, copy.second);
+	}
+
+	if (stats) {
+		stats->poses = poses.size();
+		stats->rendered = frames.size();
+		stats->tilts = tilt_count;
+		stats->thread_count = pool.thread_count();
+		stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		stats->frames_per_second = stats->seconds > 0 ? poses.size() / stats->seconds : 0;
+	}
+	return atlas;
+}
+
+std::vector<globe_batch_pose_t> globe_sprite_poses(const std::vector<int16_t>& tilts, int rotation_count)
+{
+	assert_throw(rotation_count >= 1 && rotation_count <= 0x10000);
+
+	std::vector<globe_batch_pose_t> poses;
+	for (int16_t tilt : tilts) {
+		for (int i = 0; i != rotation_count; ++i) {
+			if (rotation_count > GLOBE_ROTATION_CLASS_COUNT) {
+				// more rotations than classes, neighbours share a frame
+				poses.push_back({ tilt, uint16_t(int64_t(i) * 0x10000 / rotation_count) });
+				continue;
+			}
+			// class representatives, GLOBE_ROTATION_CLASS_COUNT gives every class once
+			const int rotation_class = int(int64_t(i) * GLOBE_ROTATION_CLASS_COUNT / rotation_count);
+			poses.push_back({ tilt, globe_pose_rotation(globe_pose_t{ 0, int16_t(rotation_class) }) });
+		}
+	}
+	return poses;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "globe_renderer.h"
+
+#include <vector>
+
+struct globe_batch_pose_t
+{
+	int16_t tilt;
+	uint16_t rotation;
+};
+
+/*
+ *  Many poses rendered into one 8-bit image, e.g. sprites of every rotation class
+ *  at a few tilts. Every pose is cropped to globe_bounding_rect() and gets a cell,
+ *  cell i is at column i % columns, row i / columns. Pixels off the globe are 0.
+ *  With columns = 1 the cells are an array of cropped bitmaps, cell i starts at
+ *  pixels[i * cell_width * cell_height].
+ */
+struct globe_atlas_t
+{
+	struct cell_t
+	{
+		int16_t tilt;
+		uint16_t rotation;
+		int x; // of the top left pixel in the atlas
+		int y;
+	};
+
+	int cell_width;  // globe_bounding_rect().w
+	int cell_height;
+	int columns;
+	int width;       // columns * cell_width, also the pitch
+	int height;
+
+	std::vector<uint8_t> pixels; // palette indices
+	std::vector<cell_t> cells;   // one per pose, in the order of the poses
+
+	const uint8_t* cell_pixels(size_t cell) const { return &pixels[size_t(cells[cell].y) * width + cells[cell].x]; }
+};
+
+struct globe_batch_stats_t
+{
+	size_t poses;
+	size_t rendered;  // distinct canonical poses, the other cells are copies
+	size_t tilts;     // distinct tilt classes
+	unsigned thread_count;
+	double seconds;
+	double frames_per_second; // poses / seconds
+};
+
+/*
+ *  Renders poses into the cells of an atlas (columns 0: about square), whole frames
+ *  in parallel on thread_count threads (0: all cores).
+ *  Every canonical pose is rendered once. The frames are sorted by tilt and every job
+ *  renders a run of up to 32 rotations of one tilt with its own renderer, so the tilt
+ *  tables and the per pixel geometry are set up once a run instead of once a frame.
+ */
+globe_atlas_t render_globe_atlas(const std::vector<globe_batch_pose_t>& poses, int columns = 0, unsigned thread_count = 0, globe_batch_stats_t* stats = nullptr);
+
+/*
+ *  rotation_count (1..65536) rotations spread over the whole circle at each tilt.
+ *  Up to GLOBE_ROTATION_CLASS_COUNT they are representatives of distinct rotation
+ *  classes (GLOBE_ROTATION_CLASS_COUNT: every class once), above that evenly spaced
+ *  rotations, several to a class.
+ */
+std::vector<globe_batch_pose_t> globe_sprite_poses(const std::vector<int16_t>& tilts, int rotation_count = GLOBE_ROTATION_CLASS_COUNT);
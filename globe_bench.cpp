@@ -0,0 +1,711 @@
+// Headless benchmark suite for the globe renderer, no SDL needed:
+//   g++ -O2 -std=c++17 -pthread globe_bench.cpp globe_asset_codec.cpp globe_assets.cpp globe_renderer.cpp globe_frame_cache.cpp globe_geometry.cpp globe_presenter.cpp globe_simd.cpp globe_sphere.cpp worker_pool.cpp initial_port.cpp -o globe_bench
+//
+//   ./globe_bench [--frames N] [--reps N] [--filter TEXT] [--json FILE] [--baseline FILE] [--threshold PERCENT]
+//
+// Every measurement runs --reps times over --frames frames (plus one warm-up run) and
+// reports the median ns/frame, the spread over the runs and globe pixels/s.
+// --json writes the results, --baseline compares with such a file and exits with 2 if
+// a measurement got slower than --threshold percent (default 10).
+// The locality/... lines at the end are simulated cache misses of the map reads, not timed.
+
+#include "globe_renderer.h"
+#include "globe_asset_codec.h"
+#include "globe_frame_cache.h"
+#include "globe_geometry.h"
+#include "globe_kernel.h"
+#include "globe_presenter.h"
+#include "globe_sphere.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace initial_port
+{
+	void precalculate_globe_rotation_lookup_table(uint16_t globe_rotation);
+	void precalculate_globe_tilt_lookup_table(int16_t globe_tilt);
+	void draw_globe(uint8_t* framebuffer);
+	void draw_frame(int16_t tilt, int16_t rotation, uint8_t* framebuffer);
+}
+
+namespace {
+
+constexpr double GLOBE_PIXELS_PER_FRAME = GLOBE_PIXEL_PAIR_COUNT * 2;
+
+const char* kernel_name(globe_kernel_t kernel)
+{
+	switch (kernel) {
+	case globe_kernel_t::CHECKED: return "checked";
+	case globe_kernel_t::SCALAR:  return "scalar";
+	case globe_kernel_t::SSE41:   return "sse4.1";
+	case globe_kernel_t::AVX2:    return "avx2";
+	}
+	return "?";
+}
+
+// appended to the kernel name, RAW (the map bytes) has no suffix
+const char* map_format_suffix(globe_map_format_t map_format)
+{
+	switch (map_format) {
+	case globe_map_format_t::RAW:     return "";
+	case globe_map_format_t::COLORED: return "-colored";
+	case globe_map_format_t::PACKED:  return "-packed";
+	case globe_map_format_t::TILED:   return "-tiled";
+	}
+	return "?";
+}
+
+struct options_t {
+	int frames = 2000;
+	int reps = 5;
+	std::string filter;
+	std::string json_path;
+	std::string baseline_path;
+	double threshold_percent = 10;
+};
+
+struct pose_t {
+	int16_t tilt;
+	uint16_t rotation;
+};
+
+struct workload_t {
+	const char* name;
+	std::vector<pose_t> poses;
+};
+
+// the same pose over and over, all 398 rotation classes at one tilt,
+// the trajectory of animated_t (main.cpp) and uniformly random poses
+std::vector<workload_t> make_workloads(int frames)
+{
+	std::vector<workload_t> workloads = {
+		{ "fixed", {} }, { "sweep", {} }, { "animated", {} }, { "random", {} },
+	};
+
+	std::mt19937 random(12345);
+	std::uniform_int_distribution<int> random_tilt(-MAX_TILT, MAX_TILT);
+	std::uniform_int_distribution<int> random_rotation(0, 0xffff);
+
+	for (int frame = 0; frame < frames; ++frame) {
+		const int rotation_class = frame % GLOBE_ROTATION_CLASS_COUNT;
+
+		workloads[0].poses.push_back({ 30, 12345 });
+		workloads[1].poses.push_back({ 30, globe_pose_rotation(globe_pose_t{ 0, int16_t(rotation_class) }) });
+		workloads[2].poses.push_back({ int16_t(-MAX_TILT * sinf(frame / 200.0f)), uint16_t(150 * frame) });
+		workloads[3].poses.push_back({ int16_t(random_tilt(random)), uint16_t(random_rotation(random)) });
+	}
+
+	return workloads;
+}
+
+struct measurement_t {
+	std::string name;
+	double ns_per_frame; // median over the runs
+	double mean_ns;
+	double stddev_ns;
+	double min_ns;
+	double pixels_per_frame; // 0: not a pixel stage
+};
+
+std::vector<measurement_t> measurements;
+volatile uint32_t sink;
+
+// frame(i) does the work of frame i
+template<typename FRAME>
+void measure(const options_t& options, const std::string& name, double pixels_per_frame, FRAME&& frame)
+{
+	if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+		return;
+	}
+
+	std::vector<double> runs;
+	for (int rep = -1; rep < options.reps; ++rep) {
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < options.frames; ++i) {
+			frame(i);
+		}
+		const auto stop = std::chrono::steady_clock::now();
+
+		// rep -1 warms the caches up
+		if (rep >= 0) {
+			runs.push_back(std::chrono::duration<double, std::nano>(stop - start).count() / options.frames);
+		}
+	}
+
+	measurement_t m{};
+	m.name = name;
+	m.pixels_per_frame = pixels_per_frame;
+
+	std::sort(runs.begin(), runs.end());
+	m.ns_per_frame = (runs.size() % 2) ? runs[runs.size() / 2] : (runs[runs.size() / 2 - 1] + runs[runs.size() / 2]) / 2;
+	m.min_ns = runs.front();
+
+	double sum = 0;
+	for (double ns : runs) {
+		sum += ns;
+	}
+	m.mean_ns = sum / runs.size();
+
+	double squares = 0;
+	for (double ns : runs) {
+		squares += (ns - m.mean_ns) * (ns - m.mean_ns);
+	}
+	m.stddev_ns = std::sqrt(squares / runs.size());
+
+	printf("%-36s %12.0f ns/frame  +-%5.1f%%", m.name.c_str(), m.ns_per_frame, 100 * m.stddev_ns / m.mean_ns);
+	if (pixels_per_frame > 0) {
+		printf("  %9.1f Mpixels/s", pixels_per_frame * 1e3 / m.ns_per_frame);
+	}
+	printf("\n");
+	fflush(stdout);
+
+	measurements.push_back(m);
+}
+
+// always rasterizes (or copies from the frame cache), a repeated pose is not skipped
+void bench_render(const options_t& options, const std::string& name, const workload_t& workload,
+	globe_kernel_t kernel, globe_map_format_t map_format, unsigned geometry_cache_size, size_t frame_cache_budget)
+{
+	globe_renderer_t renderer;
+	renderer.set_kernel(kernel);
+	renderer.set_map_format(map_format);
+	renderer.set_geometry_cache_size(geometry_cache_size);
+	renderer.set_frame_cache_budget(frame_cache_budget);
+
+	std::vector<uint8_t> framebuffer(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT);
+
+	measure(options, name, GLOBE_PIXELS_PER_FRAME, [&](int i) {
+		const pose_t& pose = workload.poses[i];
+		renderer.invalidate();
+		renderer.render(pose.tilt, pose.rotation, framebuffer.data());
+	});
+}
+
+void bench_setup(const options_t& options)
+{
+	globe_rotation_lookup_table_t rotation_lookup_table{};
+	measure(options, "setup/rotation_table", 0, [&](int i) {
+		init_globe_rotation_lookup_table(rotation_lookup_table);
+		precalculate_globe_rotation_lookup_table(rotation_lookup_table, uint16_t(i * 165));
+		sink = sink + rotation_lookup_table[2].fp_hi;
+	});
+
+	// decoded at compile time, only the lookup is left
+	measure(options, "setup/tilt_table", 0, [&](int i) {
+		sink = sink + globe_tilt_lookup_table(int16_t(i % (2 * MAX_TILT + 1) - MAX_TILT))[0];
+	});
+
+	// what the GLOBE_COMPRESSED_ASSETS build does once at startup, a few ms, so fewer frames
+	const globe_assets_t& assets = globe_assets();
+	std::vector<uint8_t> all_assets(assets.globdata, assets.globdata + GLOBDATA_BIN_SIZE);
+	all_assets.insert(all_assets.end(), assets.map, assets.map + MAP_BIN_SIZE);
+	all_assets.insert(all_assets.end(), assets.pal, assets.pal + PAL_BIN_SIZE);
+	all_assets.insert(all_assets.end(), assets.tablat, assets.tablat + TABLAT_BIN_SIZE);
+	const std::vector<uint8_t> packed_assets = pack_assets(all_assets.data(), all_assets.size());
+	options_t unpack_options = options;
+	unpack_options.frames = std::max(1, options.frames / 100);
+	measure(unpack_options, "setup/unpack_assets", 0, [&](int) {
+		unpack_assets(packed_assets.data(), packed_assets.size(), all_assets.data(), all_assets.size());
+	});
+
+	// draw_frame initializes the reference tables the precalculations work on
+	std::vector<uint8_t> framebuffer(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT);
+	initial_port::draw_frame(30, 0, framebuffer.data());
+
+	measure(options, "reference/setup/rotation_table", 0, [&](int i) {
+		initial_port::precalculate_globe_rotation_lookup_table(uint16_t(i * 165));
+	});
+	measure(options, "reference/setup/tilt_table", 0, [&](int i) {
+		initial_port::precalculate_globe_tilt_lookup_table(int16_t(i % (2 * MAX_TILT + 1) - MAX_TILT));
+	});
+}
+
+void bench_reference(const options_t& options, const std::vector<workload_t>& workloads)
+{
+	std::vector<uint8_t> framebuffer(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT);
+
+	initial_port::draw_frame(30, 0, framebuffer.data());
+	measure(options, "reference/draw_globe", GLOBE_PIXELS_PER_FRAME, [&](int) {
+		initial_port::draw_globe(framebuffer.data());
+	});
+
+	for (const workload_t& workload : workloads) {
+		measure(options, std::string("reference/draw_frame/") + workload.name, GLOBE_PIXELS_PER_FRAME, [&](int i) {
+			const pose_t& pose = workload.poses[i];
+			initial_port::draw_frame(pose.tilt, int16_t(pose.rotation), framebuffer.data());
+		});
+	}
+}
+
+// cell_count random map bytes get their overlay bit flipped every frame, then the frame is
+// brought up to date by redrawing just those pixels or by rendering it again
+void bench_map_edits(const options_t& options, globe_kernel_t kernel)
+{
+	std::vector<uint8_t> framebuffer(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT);
+	std::vector<size_t> cells(4096);
+	std::mt19937 random(12345);
+	for (size_t& cell : cells) {
+		cell = random() % MAP_BIN_SIZE;
+	}
+
+	for (int cell_count : { 10, 100, 1000 }) {
+		for (bool incremental : { true, false }) {
+			globe_renderer_t renderer;
+			renderer.set_kernel(kernel);
+			std::vector<uint8_t> map(globe_assets().map, globe_assets().map + MAP_BIN_SIZE);
+			renderer.render(30, 12345, framebuffer.data());
+
+			const std::string name = std::string("edit/") + (incremental ? "redraw/" : "render/") + std::to_string(cell_count);
+			measure(options, name, 0, [&](int i) {
+				for (int k = 0; k != cell_count; ++k) {
+					const size_t cell = cells[(size_t(i) * cell_count + k) % cells.size()];
+					map[cell] ^= 0x10;
+					renderer.set_map_cell(cell, map[cell]);
+				}
+				if (incremental) {
+					sink = sink + renderer.redraw_map_edits().w;
+				} else {
+					renderer.invalidate();
+					renderer.render(30, 12345, framebuffer.data());
+				}
+			});
+		}
+	}
+}
+
+// frames that also fill the pick buffer, and pick() under 1000 mouse positions
+void bench_picking(const options_t& options, const std::vector<workload_t>& workloads, globe_kernel_t kernel)
+{
+	std::vector<uint8_t> framebuffer(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT);
+
+	for (const workload_t& workload : workloads) {
+		for (unsigned geometry_cache_size : { 0u, 4u }) {
+			globe_renderer_t renderer;
+			renderer.set_kernel(kernel);
+			renderer.set_geometry_cache_size(geometry_cache_size);
+			renderer.set_picking(true);
+
+			const std::string path = geometry_cache_size ? "geometry" : kernel_name(kernel);
+			measure(options, "pick/render/" + path + "/" + workload.name, GLOBE_PIXELS_PER_FRAME, [&](int i) {
+				const pose_t& pose = workload.poses[i];
+				renderer.invalidate();
+				renderer.render(pose.tilt, pose.rotation, framebuffer.data());
+			});
+		}
+	}
+
+	globe_renderer_t renderer;
+	renderer.set_picking(true);
+	renderer.render(30, 12345, framebuffer.data());
+
+	const framebuffer_rect_t& rect = globe_bounding_rect();
+	measure(options, "pick/lookup/1000", 0, [&](int i) {
+		for (int k = 0; k != 1000; ++k) {
+			const globe_pick_t p = renderer.pick(rect.x + (i * 7 + k * 13) % rect.w, rect.y + (i * 3 + k * 11) % rect.h);
+			sink = sink + p.ring + p.column;
+		}
+	});
+}
+
+// globe_sphere_renderer_t at a few scales: building the tables and the map, and frames of the workload
+void bench_sphere(const options_t& options, const workload_t& workload)
+{
+	for (int scale : { 1, 2, 4, 8 }) {
+		const std::string suffix = "x" + std::to_string(scale);
+
+		// synthesize_globe_sphere_tables checks this as well, 100% or it throws
+		if (options.filter.empty() || ("sphere/match/" + suffix).find(options.filter) != std::string::npos) {
+			const globe_sphere_tables_match_t match = compare_globe_sphere_tables(
+				downsample_globe_sphere_tables(synthesize_globe_sphere_tables(scale), scale), shipped_globe_sphere_tables());
+			printf("sphere/match/%s downsampled vs shipped: contour %.1f%%  gd_vals %.1f%%  table0 %.1f%%  table1 %.1f%%  rings %.1f%%\n",
+				suffix.c_str(), 100 * match.contour, 100 * match.gd_vals, 100 * match.table0, 100 * match.table1, 100 * match.rings);
+		}
+
+		// a few ms a scale, so fewer frames
+		options_t setup_options = options;
+		setup_options.frames = std::max(1, options.frames / 1000);
+		measure(setup_options, "sphere/setup/" + suffix, 0, [&](int) {
+			globe_sphere_renderer_t renderer(scale);
+			sink = sink + renderer.width();
+		});
+
+		// scale^2 times the pixels, the same time a run
+		options_t render_options = options;
+		render_options.frames = std::max(1, options.frames / (scale * scale));
+
+		globe_sphere_renderer_t renderer(scale);
+		std::vector<uint8_t> framebuffer(size_t(renderer.width()) * renderer.height());
+		measure(render_options, "sphere/render/" + suffix + "/" + workload.name, double(renderer.tables().gd_vals.size()) * 2, [&](int i) {
+			const pose_t& pose = workload.poses[i];
+			renderer.render(pose.tilt, pose.rotation, framebuffer.data(), renderer.width());
+		});
+	}
+}
+
+// globe_presenter_t::present into a 32 bit or 8-bit surface
+void bench_present(const options_t& options)
+{
+	std::vector<uint8_t> framebuffer(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT);
+	globe_renderer_t().render(30, 0, framebuffer.data());
+
+	globe_presenter_t presenter;
+
+	for (bool indexed : { false, true }) {
+		for (int factor : { 1, 2, 5, 8 }) {
+			const int pitch = FRAMEBUFFER_WIDTH * factor * (indexed ? 1 : 4);
+			std::vector<uint8_t> surface(size_t(pitch) * FRAMEBUFFER_HEIGHT * factor);
+
+			for (bool globe_only : { false, true }) {
+				const framebuffer_rect_t& rect = globe_only ? globe_bounding_rect() : FRAMEBUFFER_RECT;
+				const std::string name = std::string("present/") + (indexed ? "8bit" : "32bit") +
+					"/x" + std::to_string(factor) + (globe_only ? "/globe" : "/full");
+
+				measure(options, name, double(rect.w) * rect.h, [&](int) {
+					if (indexed) {
+						presenter.present_indexed(framebuffer.data(), factor, surface.data(), pitch, rect);
+					} else {
+						presenter.present(framebuffer.data(), factor, surface.data(), pitch, rect);
+					}
+				});
+			}
+		}
+	}
+}
+
+// a set associative LRU data cache of 64 byte lines, counts the misses of the reads it is fed
+class cache_model_t
+{
+public:
+	// size / 64 / ways has to be a power of 2
+	cache_model_t(size_t size, int ways)
+		: ways(ways)
+		, set_mask(size / 64 / ways - 1)
+		, tags(size / 64, -1)
+	{
+	}
+
+	void read(int64_t address)
+	{
+		const int64_t line = address >> 6;
+		++read_count;
+		// the most recently used line, hit without touching the order
+		if (line == last_line) {
+			return;
+		}
+		last_line = line;
+
+		int64_t* set = &tags[(size_t(line) & set_mask) * ways];
+		int way = 0;
+		while (way != ways && set[way] != line) {
+			++way;
+		}
+		if (way == ways) {
+			++miss_count;
+			way = ways - 1;
+		}
+		// most recently used first
+		for (; way != 0; --way) {
+			set[way] = set[way - 1];
+		}
+		set[0] = line;
+	}
+
+	uint64_t reads() const { return read_count; }
+	uint64_t misses() const { return miss_count; }
+
+private:
+	const int ways;
+	const size_t set_mask;
+	std::vector<int64_t> tags;
+	int64_t last_line = -1;
+	uint64_t read_count = 0;
+	uint64_t miss_count = 0;
+};
+
+/*
+ *  The map reads of all canonical poses, in the order the scalar kernel and the geometry
+ *  path do them, fed to simulated caches for the linear layout (RAW, COLORED) and for
+ *  TILED. The small caches stand in for renderers sharing a core.
+ *  The rotation classes of a tilt run in order through one set of caches, the tilts run
+ *  in parallel. No timing, so not in --json.
+ */
+void bench_map_locality(const options_t& options)
+{
+	const char* const LAYOUT_NAMES[] = { "locality/linear", "locality/tiled" };
+	if (!options.filter.empty() && std::none_of(std::begin(LAYOUT_NAMES), std::end(LAYOUT_NAMES),
+			[&](const char* name) { return std::string(name).find(options.filter) != std::string::npos; })) {
+		return;
+	}
+
+	const globe_program_t& program = globe_program();
+	const kernel_map_planes_t planes(globe_assets().map);
+	constexpr size_t CACHE_SIZES[] = { 8 << 10, 16 << 10, 32 << 10 };
+	constexpr int CACHE_WAYS = 8;
+	const size_t line_counts[] = { MAP_BIN_SIZE / 64 + 1, planes.tiled.size() / 64 + 1 };
+
+	// per layout: the reads and misses per cache size, the distinct lines of every frame summed up
+	struct counts_t
+	{
+		uint64_t reads = 0;
+		uint64_t misses[std::size(CACHE_SIZES)] = {};
+		uint64_t lines = 0;
+	};
+	counts_t totals[2];
+	std::mutex totals_mutex;
+
+	const auto sweep_tilt = [&](int tilt_class) {
+		struct layout_t
+		{
+			std::vector<cache_model_t> caches;
+			std::vector<int> line_frame; // last frame the line was read in
+			uint64_t lines = 0;
+		};
+		layout_t layouts[2];
+		for (int i = 0; i != 2; ++i) {
+			for (size_t size : CACHE_SIZES) {
+				layouts[i].caches.emplace_back(size, CACHE_WAYS);
+			}
+			layouts[i].line_frame.assign(line_counts[i], -1);
+		}
+
+		const auto read = [](layout_t& layout, int64_t address, int frame) {
+			for (cache_model_t& cache : layout.caches) {
+				cache.read(address);
+			}
+			int& line_frame = layout.line_frame[size_t(address >> 6)];
+			if (line_frame != frame) {
+				line_frame = frame;
+				++layout.lines;
+			}
+		};
+
+		globe_geometry_t geometry;
+		build_globe_geometry(geometry, globe_pose_tilt(globe_pose_t{ int16_t(tilt_class), 0 }));
+		globe_rotation_lookup_table_t rotation_lookup_table{};
+		init_globe_rotation_lookup_table(rotation_lookup_table);
+
+		for (int frame = 0; frame != GLOBE_ROTATION_CLASS_COUNT; ++frame) {
+			precalculate_globe_rotation_lookup_table(rotation_lookup_table, globe_pose_rotation(globe_pose_t{ 0, int16_t(frame) }));
+
+			for (const auto& row : program.rows) {
+				for (int index = 0; index < row.count; ++index) {
+					const globe_geometry_pixel_t& g = geometry[row.first_pixel + index];
+					const int fp_hi = rotation_lookup_table[g.entry].fp_hi;
+
+					int left_ofs = fp_hi - g.gd;
+					if (left_ofs < 0) {
+						left_ofs += g.grlt_1;
+					}
+					int right_ofs = fp_hi + g.gd - g.grlt_1;
+					if (right_ofs < 0) {
+						right_ofs += g.grlt_1;
+					}
+
+					for (int column : { left_ofs, right_ofs }) {
+						read(layouts[0], MAP_CENTER_OFS + g.grlt_0 + column, frame);
+						read(layouts[1], kernel_tiled_map_index(planes.ring_tiles.data(), g.ring, column), frame);
+					}
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(totals_mutex);
+		for (int i = 0; i != 2; ++i) {
+			totals[i].reads += layouts[i].caches[0].reads();
+			for (size_t k = 0; k != std::size(CACHE_SIZES); ++k) {
+				totals[i].misses[k] += layouts[i].caches[k].misses();
+			}
+			totals[i].lines += layouts[i].lines;
+		}
+	};
+
+	const auto start = std::chrono::steady_clock::now();
+	worker_pool_t pool(std::max(1u, std::thread::hardware_concurrency()));
+	pool.run(GLOBE_TILT_CLASS_COUNT, sweep_tilt);
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	const int frames = GLOBE_TILT_CLASS_COUNT * GLOBE_ROTATION_CLASS_COUNT;
+	printf("map reads of all %d poses, %d way LRU caches (%.1f s)\n", frames, CACHE_WAYS, seconds);
+	for (int i = 0; i != 2; ++i) {
+		printf("%-36s %6.1f lines/frame  misses", LAYOUT_NAMES[i], double(totals[i].lines) / frames);
+		for (size_t k = 0; k != std::size(CACHE_SIZES); ++k) {
+			printf("  %5.2f%% @%2zu KB", 100.0 * totals[i].misses[k] / totals[i].reads, CACHE_SIZES[k] >> 10);
+		}
+		printf("\n");
+	}
+	fflush(stdout);
+}
+
+bool write_json(const std::string& path, const options_t& options)
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file) {
+		fprintf(stderr, "can't write %s\n", path.c_str());
+		return false;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"kernel\": \"%s\",\n", kernel_name(best_globe_kernel()));
+	fprintf(file, "  \"frames\": %d,\n", options.frames);
+	fprintf(file, "  \"reps\": %d,\n", options.reps);
+	fprintf(file, "  \"results\": [\n");
+	for (size_t i = 0; i != measurements.size(); ++i) {
+		const measurement_t& m = measurements[i];
+		fprintf(file, "    {\"name\": \"%s\", \"ns_per_frame\": %.1f, \"mean_ns\": %.1f, \"stddev_ns\": %.1f, \"min_ns\": %.1f, \"pixels_per_s\": %.0f}%s\n",
+			m.name.c_str(), m.ns_per_frame, m.mean_ns, m.stddev_ns, m.min_ns,
+			m.pixels_per_frame > 0 ? m.pixels_per_frame * 1e9 / m.ns_per_frame : 0.0,
+			(i + 1 != measurements.size()) ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+
+	fclose(file);
+	return true;
+}
+
+struct baseline_entry_t {
+	std::string name;
+	double ns_per_frame;
+};
+
+// only reads what write_json writes: the "name" and "ns_per_frame" of every result
+bool read_baseline(const std::string& path, std::vector<baseline_entry_t>& baseline)
+{
+	FILE* file = fopen(path.c_str(), "r");
+	if (!file) {
+		fprintf(stderr, "can't read %s\n", path.c_str());
+		return false;
+	}
+
+	std::string text;
+	char buffer[4096];
+	for (size_t n; (n = fread(buffer, 1, sizeof(buffer), file)) != 0;) {
+		text.append(buffer, n);
+	}
+	fclose(file);
+
+	const std::string NAME = "\"name\": \"";
+	const std::string NS = "\"ns_per_frame\": ";
+	for (size_t pos = text.find(NAME); pos != std::string::npos; pos = text.find(NAME, pos)) {
+		pos += NAME.size();
+		const size_t name_end = text.find('"', pos);
+		const size_t ns_pos = text.find(NS, name_end);
+		if (name_end == std::string::npos || ns_pos == std::string::npos) {
+			break;
+		}
+		baseline.push_back({ text.substr(pos, name_end - pos), strtod(text.c_str() + ns_pos + NS.size(), nullptr) });
+		pos = ns_pos;
+	}
+	return true;
+}
+
+// number of regressions
+int compare_with_baseline(const std::vector<baseline_entry_t>& baseline, double threshold_percent)
+{
+	printf("\nbaseline comparison (threshold %.1f%%)\n", threshold_percent);
+
+	int regressions = 0;
+	for (const measurement_t& m : measurements) {
+		auto it = std::find_if(baseline.begin(), baseline.end(), [&](const baseline_entry_t& entry) { return entry.name == m.name; });
+		if (it == baseline.end() || it->ns_per_frame <= 0) {
+			printf("%-36s %12.0f ns/frame  (not in the baseline)\n", m.name.c_str(), m.ns_per_frame);
+			continue;
+		}
+
+		const double change = 100 * (m.ns_per_frame - it->ns_per_frame) / it->ns_per_frame;
+		const bool regression = change > threshold_percent;
+		regressions += regression;
+		printf("%-36s %12.0f -> %12.0f ns/frame  %+7.1f%%%s\n", m.name.c_str(), it->ns_per_frame, m.ns_per_frame, change,
+			regression ? "  REGRESSION" : "");
+	}
+	return regressions;
+}
+
+bool parse_options(int argc, char** argv, options_t& options)
+{
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool has_value = i + 1 < argc;
+
+		if (arg == "--frames" && has_value) {
+			options.frames = atoi(argv[++i]);
+		} else if (arg == "--reps" && has_value) {
+			options.reps = atoi(argv[++i]);
+		} else if (arg == "--filter" && has_value) {
+			options.filter = argv[++i];
+		} else if (arg == "--json" && has_value) {
+			options.json_path = argv[++i];
+		} else if (arg == "--baseline" && has_value) {
+			options.baseline_path = argv[++i];
+		} else if (arg == "--threshold" && has_value) {
+			options.threshold_percent = atof(argv[++i]);
+		} else {
+			return false;
+		}
+	}
+	return options.frames > 0 && options.reps > 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	options_t options;
+	if (!parse_options(argc, argv, options)) {
+		fprintf(stderr, "usage: %s [--frames N] [--reps N] [--filter TEXT] [--json FILE] [--baseline FILE] [--threshold PERCENT]\n", argv[0]);
+		return 1;
+	}
+
+	// read first, a missing baseline should not cost a whole run
+	std::vector<baseline_entry_t> baseline;
+	if (!options.baseline_path.empty() && !read_baseline(options.baseline_path, baseline)) {
+		return 1;
+	}
+
+	const globe_kernel_t best = best_globe_kernel();
+	const std::vector<workload_t> workloads = make_workloads(options.frames);
+
+	bench_setup(options);
+
+	for (const workload_t& workload : workloads) {
+		// CHECKED always reads the map bytes
+		bench_render(options, std::string("render/checked/") + workload.name, workload, globe_kernel_t::CHECKED, globe_map_format_t::RAW, 0, 0);
+		for (globe_map_format_t map_format : { globe_map_format_t::RAW, globe_map_format_t::COLORED, globe_map_format_t::PACKED, globe_map_format_t::TILED }) {
+			const std::string suffix = map_format_suffix(map_format);
+			for (globe_kernel_t kernel : { globe_kernel_t::SCALAR, globe_kernel_t::SSE41, globe_kernel_t::AVX2 }) {
+				if (int(kernel) <= int(best)) {
+					bench_render(options, std::string("render/") + kernel_name(kernel) + suffix + "/" + workload.name, workload, kernel, map_format, 0, 0);
+				}
+			}
+			bench_render(options, "render/geometry" + suffix + "/" + workload.name, workload, best, map_format, 4, 0);
+		}
+		bench_render(options, std::string("render/frames/") + workload.name, workload, best, globe_map_format_t::COLORED, 4, 32 << 20);
+	}
+
+	bench_map_edits(options, best);
+	bench_picking(options, workloads, best);
+	bench_sphere(options, workloads[2]);
+	bench_reference(options, workloads);
+	bench_present(options);
+	bench_map_locality(options);
+
+	if (!options.json_path.empty() && !write_json(options.json_path, options)) {
+		return 1;
+	}
+
+	if (!baseline.empty() && compare_with_baseline(baseline, options.threshold_percent) != 0) {
+		return 2;
+	}
+
+	return 0;
+}
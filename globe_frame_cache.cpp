@@ -0,0 +1,119 @@
+#include "globe_frame_cache.h"
+
+#include <cstring>
+
+globe_frame_cache_t::globe_frame_cache_t(size_t byte_budget)
+	: byte_budget(byte_budget)
+	, pose_slots(GLOBE_POSE_COUNT, -1)
+{
+	const size_t index_size = pose_slots.size() * sizeof(int);
+	const size_t slot_size = sizeof(slot_t) + FRAME_SIZE;
+	max_slots = (byte_budget > index_size) ? (byte_budget - index_size) / slot_size : 0;
+}
+
+void globe_frame_cache_t::unlink(int slot)
+{
+	slot_t& s = slots[slot];
+	if (s.prev >= 0) {
+		slots[s.prev].next = s.next;
+	} else {
+		head = s.next;
+	}
+	if (s.next >= 0) {
+		slots[s.next].prev = s.prev;
+	} else {
+		tail = s.prev;
+	}
+	s.prev = -1;
+	s.next = -1;
+}
+
+void globe_frame_cache_t::push_front(int slot)
+{
+	slot_t& s = slots[slot];
+	s.prev = -1;
+	s.next = head;
+	if (head >= 0) {
+		slots[head].prev = slot;
+	}
+	head = slot;
+	if (tail < 0) {
+		tail = slot;
+	}
+}
+
+bool globe_frame_cache_t::load(globe_pose_t pose, uint8_t* dst, int dst_pitch)
+{
+	const int slot = pose_slots[globe_pose_index(pose)];
+	if (slot < 0) {
+		++miss_count;
+		return false;
+	}
+	++hit_count;
+
+	if (slot != head) {
+		unlink(slot);
+		push_front(slot);
+	}
+
+	const uint8_t* pixels = slots[slot].pixels.data();
+	for (const auto& row : globe_program().rows) {
+		memcpy(&dst[row.y * dst_pitch + row.x - row.count], &pixels[row.first_pixel * 2], row.count * 2);
+	}
+	return true;
+}
+
+void globe_frame_cache_t::store(globe_pose_t pose, const uint8_t* src, int src_pitch)
+{
+	if (max_slots == 0) {
+		return;
+	}
+
+	const int pose_index = globe_pose_index(pose);
+	int slot = pose_slots[pose_index];
+
+	if (slot >= 0) {
+		unlink(slot);
+	} else if (free_head >= 0) {
+		slot = free_head;
+		free_head = slots[slot].next;
+		--free_count;
+	} else if (slots.size() < max_slots) {
+		slot = int(slots.size());
+		slots.push_back(slot_t{ pose_index, -1, -1, std::vector<uint8_t>(FRAME_SIZE) });
+	} else {
+		// reuse the least recently used frame
+		slot = tail;
+		unlink(slot);
+		pose_slots[slots[slot].pose_index] = -1;
+		++eviction_count;
+	}
+
+	slots[slot].pose_index = pose_index;
+	pose_slots[pose_index] = slot;
+	push_front(slot);
+
+	uint8_t* pixels = slots[slot].pixels.data();
+	for (const auto& row : globe_program().rows) {
+		memcpy(&pixels[row.first_pixel * 2], &src[row.y * src_pitch + row.x - row.count], row.count * 2);
+	}
+}
+
+void globe_frame_cache_t::clear()
+{
+	// only the cached poses, not the whole index
+	while (head >= 0) {
+		const int slot = head;
+		unlink(slot);
+		pose_slots[slots[slot].pose_index] = -1;
+		slots[slot].pose_index = -1;
+		slots[slot].next = free_head;
+		free_head = slot;
+		++free_count;
+	}
+}
+
+size_t globe_frame_cache_t::memory_size() const
+{
+	return pose_slots.size() * sizeof(int) + slots.size() * (sizeof(slot_t) + FRAME_SIZE);
+}
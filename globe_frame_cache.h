@@ -0,0 +1,61 @@
+#pragma once
+
+#include "globe_renderer.h"
+
+/*
+ *  Rendered frames by canonical pose, least recently used goes first once
+ *  the byte budget is used up.
+ *  Only the globe pixels are kept: every program row is one span of 2 * count
+ *  pixels in the framebuffer, the spans are stored back to back, so a frame is
+ *  GLOBE_PIXEL_PAIR_COUNT * 2 bytes (~11 KB) and restoring it is one memcpy per row.
+ */
+class globe_frame_cache_t
+{
+public:
+	static constexpr size_t FRAME_SIZE = GLOBE_PIXEL_PAIR_COUNT * 2;
+
+	explicit globe_frame_cache_t(size_t byte_budget);
+
+	// copies the frame of pose into dst, false if it is not cached
+	bool load(globe_pose_t pose, uint8_t* dst, int dst_pitch);
+	// keeps the globe pixels of src as the frame of pose
+	void store(globe_pose_t pose, const uint8_t* src, int src_pitch);
+	// forgets every frame (the map changed), keeps their memory for the next ones and the counters
+	void clear();
+
+	size_t budget() const { return byte_budget; }
+	size_t memory_size() const;
+	size_t frame_count() const { return slots.size() - free_count; }
+
+	uint64_t hits() const { return hit_count; }
+	uint64_t misses() const { return miss_count; }
+	uint64_t evictions() const { return eviction_count; }
+
+private:
+	// doubly linked LRU list over the slots, head is the most recently used
+	struct slot_t
+	{
+		int pose_index;
+		int prev;
+		int next;
+		std::vector<uint8_t> pixels;
+	};
+
+	void unlink(int slot);
+	void push_front(int slot);
+
+	size_t byte_budget;
+	size_t max_slots;
+
+	std::vector<int> pose_slots; // by globe_pose_index, -1: not cached
+	std::vector<slot_t> slots;
+	int head = -1;
+	int tail = -1;
+	// cleared slots, linked by next
+	int free_head = -1;
+	size_t free_count = 0;
+
+	uint64_t hit_count = 0;
+	uint64_t miss_count = 0;
+	uint64_t eviction_count = 0;
+};
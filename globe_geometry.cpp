@@ -0,0 +1,261 @@
+#include "globe_geometry.h"
+#include "globe_kernel.h"
+
+namespace {
+
+// kernel_pixel_color of every map value
+constexpr std::array<uint8_t, 256> make_pixel_colors()
+{
+	std::array<uint8_t, 256> colors{};
+	for (int value = 0; value != 256; ++value) {
+		colors[value] = kernel_pixel_color(uint8_t(value));
+	}
+	return colors;
+}
+
+constexpr std::array<uint8_t, 256> PIXEL_COLORS = make_pixel_colors();
+
+}
+
+void build_globe_geometry(globe_geometry_t& geometry, int16_t tilt)
+{
+	const globe_program_t& program = globe_program();
+	const globe_tilt_lookup_table_t& tilt_lookup_table = globe_tilt_lookup_table(tilt);
+	const globe_rotation_lookup_table_t& rotation_lookup_table = base_globe_rotation_lookup_table();
+
+	geometry.resize(program.gd_vals.size());
+
+	for (const auto& row : program.rows) {
+		for (int index = 0; index < row.count; ++index) {
+			const int pixel = row.first_pixel + index;
+
+			// func1 without fp_hi
+			const int32_t tilt_entry = decode_tilt_entry(tilt_lookup_table[MAX_TILT + program.gd_vals[pixel]]);
+			const uint16_t slice_value = program.slice_values[index * SLICE_VALUE_COUNT + (tilt_entry & 0xff)];
+			const int entry_index = slice_value & 0xff;
+			const auto& entry = rotation_lookup_table[entry_index];
+			const int table1 = slice_value >> 8;
+
+			globe_geometry_pixel_t& g = geometry[pixel];
+			g.gd = int16_t((tilt_entry & TILT_LO_NEGATIVE) ? entry.unk1 - table1 : table1);
+			g.grlt_0 = int16_t((tilt_entry & TILT_NEGATIVE) ? -entry.unk0 : entry.unk0);
+			g.grlt_1 = uint16_t(entry.unk1 * 2);
+			g.entry = uint8_t(entry_index);
+			g.ring = uint8_t(kernel_map_ring(entry_index, (tilt_entry & TILT_NEGATIVE) != 0));
+		}
+	}
+}
+
+namespace {
+
+// color_map_offset of both pixels of the pair
+inline
+void geometry_columns(const globe_geometry_pixel_t& g, int fp_hi, int& left_ofs, int& right_ofs)
+{
+	left_ofs = fp_hi - g.gd;
+	if (left_ofs < 0) {
+		left_ofs += g.grlt_1;
+	}
+	right_ofs = fp_hi + g.gd - g.grlt_1;
+	if (right_ofs < 0) {
+		right_ofs += g.grlt_1;
+	}
+}
+
+template<globe_map_format_t FORMAT>
+uint8_t geometry_map_color(const kernel_map_t& map, const globe_geometry_pixel_t& g, int column)
+{
+	// one table lookup instead of the branches of kernel_pixel_color
+	if constexpr (FORMAT == globe_map_format_t::RAW) {
+		return PIXEL_COLORS[map.raw[g.grlt_0 + column]];
+	} else {
+		return kernel_map_color<FORMAT>(map, g.ring, g.grlt_0, column);
+	}
+}
+
+template<globe_map_format_t FORMAT>
+void draw_rows(
+	const globe_geometry_t& geometry,
+	const globe_entry_fp_hi_t& entry_fp_hi,
+	const kernel_map_t& map,
+	int first_row,
+	int end_row,
+	uint8_t* framebuffer,
+	int pitch)
+{
+	const globe_program_t& program = globe_program();
+
+	for (int r = first_row; r < end_row; ++r) {
+		const auto& row = program.rows[r];
+		const globe_geometry_pixel_t* pixels = &geometry[row.first_pixel];
+
+		uint8_t* right = &framebuffer[row.y * pitch + row.x];
+		uint8_t* left = right - 1;
+
+		for (int index = 0; index < row.count; ++index) {
+			const globe_geometry_pixel_t& g = pixels[index];
+			int left_ofs, right_ofs;
+			geometry_columns(g, entry_fp_hi[g.entry], left_ofs, right_ofs);
+
+			left[-index] = geometry_map_color<FORMAT>(map, g, left_ofs);
+			right[index] = geometry_map_color<FORMAT>(map, g, right_ofs);
+		}
+	}
+}
+
+}
+
+void draw_globe_geometry_rows(
+	const globe_geometry_t& geometry,
+	const globe_entry_fp_hi_t& entry_fp_hi,
+	const kernel_map_t& map,
+	globe_map_format_t map_format,
+	int first_row,
+	int end_row,
+	uint8_t* framebuffer,
+	int pitch)
+{
+	switch (map_format) {
+	case globe_map_format_t::COLORED:
+		draw_rows<globe_map_format_t::COLORED>(geometry, entry_fp_hi, map, first_row, end_row, framebuffer, pitch);
+		break;
+	case globe_map_format_t::PACKED:
+		draw_rows<globe_map_format_t::PACKED>(geometry, entry_fp_hi, map, first_row, end_row, framebuffer, pitch);
+		break;
+	case globe_map_format_t::TILED:
+		draw_rows<globe_map_format_t::TILED>(geometry, entry_fp_hi, map, first_row, end_row, framebuffer, pitch);
+		break;
+	default:
+		draw_rows<globe_map_format_t::RAW>(geometry, entry_fp_hi, map, first_row, end_row, framebuffer, pitch);
+		break;
+	}
+}
+
+void draw_globe_geometry_map_offset_rows(
+	const globe_geometry_t& geometry,
+	const globe_entry_fp_hi_t& entry_fp_hi,
+	int first_row,
+	int end_row,
+	uint16_t* map_offsets,
+	const framebuffer_rect_t& rect)
+{
+	const globe_program_t& program = globe_program();
+
+	for (int r = first_row; r < end_row; ++r) {
+		const auto& row = program.rows[r];
+		const globe_geometry_pixel_t* pixels = &geometry[row.first_pixel];
+
+		uint16_t* right = &map_offsets[(row.y - rect.y) * rect.w + row.x - rect.x];
+		uint16_t* left = right - 1;
+
+		for (int index = 0; index < row.count; ++index) {
+			const globe_geometry_pixel_t& g = pixels[index];
+			int left_ofs, right_ofs;
+			geometry_columns(g, entry_fp_hi[g.entry], left_ofs, right_ofs);
+
+			left[-index] = uint16_t(MAP_CENTER_OFS + g.grlt_0 + left_ofs);
+			right[index] = uint16_t(MAP_CENTER_OFS + g.grlt_0 + right_ofs);
+		}
+	}
+}
+
+void globe_map_pixel_index_t::build(const globe_geometry_t& geometry, const globe_entry_fp_hi_t& entry_fp_hi, int pitch)
+{
+	const globe_program_t& program = globe_program();
+
+	// the map byte and framebuffer offset of every pixel, in draw_rows order
+	pixels.resize(geometry.size() * 2);
+	std::pair<uint32_t, uint32_t>* pixel = pixels.data();
+	for (const auto& row : program.rows) {
+		const uint32_t right = uint32_t(row.y * pitch + row.x);
+		for (int index = 0; index < row.count; ++index) {
+			const globe_geometry_pixel_t& g = geometry[row.first_pixel + index];
+			int left_ofs, right_ofs;
+			geometry_columns(g, entry_fp_hi[g.entry], left_ofs, right_ofs);
+
+			*pixel++ = { uint32_t(MAP_CENTER_OFS + g.grlt_0 + left_ofs), right - 1 - index };
+			*pixel++ = { uint32_t(MAP_CENTER_OFS + g.grlt_0 + right_ofs), right + index };
+		}
+	}
+
+	// counting sort by map byte. pixel_end[b + 1] counts the pixels of byte b, the running
+	// sums make pixel_end[b] where byte b starts, placing its pixels moves it to where b ends
+	pixel_end.assign(MAP_BIN_SIZE + 1, 0);
+	for (const auto& p : pixels) {
+		++pixel_end[p.first + 1];
+	}
+	uint16_t sum = 0;
+	for (uint16_t& end : pixel_end) {
+		sum = uint16_t(sum + end);
+		end = sum;
+	}
+	pixel_offsets.resize(pixels.size());
+	for (const auto& p : pixels) {
+		pixel_offsets[pixel_end[p.first]++] = p.second;
+	}
+}
+
+globe_geometry_cache_t::globe_geometry_cache_t(unsigned capacity)
+	: max_entries(capacity)
+{
+}
+
+void globe_geometry_cache_t::set_capacity(unsigned capacity)
+{
+	max_entries = capacity;
+	while (entries.size() > max_entries) {
+		auto oldest = entries.begin();
+		for (auto it = entries.begin(); it != entries.end(); ++it) {
+			if (it->last_use < oldest->last_use) {
+				oldest = it;
+			}
+		}
+		entries.erase(oldest);
+	}
+}
+
+const globe_geometry_t* globe_geometry_cache_t::find(int tilt_class)
+{
+	for (auto& entry : entries) {
+		if (entry.tilt_class == tilt_class) {
+			entry.last_use = ++use_counter;
+			++hit_count;
+			return &entry.geometry;
+		}
+	}
+	return nullptr;
+}
+
+const globe_geometry_t& globe_geometry_cache_t::insert(int tilt_class)
+{
+	assert_throw(max_entries > 0);
+	++miss_count;
+
+	entry_t* slot = nullptr;
+	if (entries.size() < max_entries) {
+		entries.push_back(entry_t{});
+		slot = &entries.back();
+	} else {
+		// reuse the buffer of the least recently used tilt
+		slot = &entries[0];
+		for (auto& entry : entries) {
+			if (entry.last_use < slot->last_use) {
+				slot = &entry;
+			}
+		}
+	}
+
+	slot->tilt_class = tilt_class;
+	slot->last_use = ++use_counter;
+	build_globe_geometry(slot->geometry, int16_t(tilt_class - MAX_TILT));
+	return slot->geometry;
+}
+
+size_t globe_geometry_cache_t::memory_size() const
+{
+	size_t size = 0;
+	for (const auto& entry : entries) {
+		size += entry.geometry.capacity() * sizeof(globe_geometry_pixel_t);
+	}
+	return size;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "globe_renderer.h"
+
+#include <utility>
+
+struct kernel_map_t;
+
+/*
+ *  For a fixed tilt the func1 results of every pixel pair (gd, grlt_0, grlt_1 and the
+ *  rotation table entry) do not depend on the rotation, only entry.fp_hi does.
+ *  globe_geometry_t keeps them per pixel pair, parallel to globe_program_t::gd_vals,
+ *  so a rotation-only frame is just the color_map_offset wrap and the map lookup.
+ */
+struct globe_geometry_pixel_t
+{
+	int16_t gd;
+	int16_t grlt_0;
+	uint16_t grlt_1;
+	uint8_t entry; // rotation_lookup_table index
+	uint8_t ring;  // kernel_map_ring(entry, grlt_0 < 0)
+};
+static_assert(sizeof(globe_geometry_pixel_t) == 8, "wrong size");
+
+using globe_geometry_t = std::vector<globe_geometry_pixel_t>;
+
+// fp_hi of the rotation table entries, the only rotation dependent part
+using globe_entry_fp_hi_t = std::array<int16_t, MAX_TILT+1>;
+
+void build_globe_geometry(globe_geometry_t& geometry, int16_t tilt);
+
+void draw_globe_geometry_rows(
+	const globe_geometry_t& geometry,
+	const globe_entry_fp_hi_t& entry_fp_hi,
+	const kernel_map_t& map,
+	globe_map_format_t map_format,
+	int first_row,
+	int end_row,
+	uint8_t* framebuffer,
+	int pitch);
+
+// the MAP.BIN offset of every pixel draw_globe_geometry_rows draws, into map_offsets holding rect
+void draw_globe_geometry_map_offset_rows(
+	const globe_geometry_t& geometry,
+	const globe_entry_fp_hi_t& entry_fp_hi,
+	int first_row,
+	int end_row,
+	uint16_t* map_offsets,
+	const framebuffer_rect_t& rect);
+
+/*
+ *  The other way round for one pose: the framebuffer pixels (y * pitch + x) that show
+ *  a MAP.BIN byte. globe_renderer_t builds it when the map is edited, to redraw only
+ *  the pixels of the edited bytes.
+ */
+class globe_map_pixel_index_t
+{
+public:
+	void build(const globe_geometry_t& geometry, const globe_entry_fp_hi_t& entry_fp_hi, int pitch);
+
+	// [pixels_begin, pixels_end) of MAP.BIN byte map_index, most bytes show in no pixel
+	const uint32_t* pixels_begin(size_t map_index) const { return pixel_offsets.data() + (map_index ? pixel_end[map_index - 1] : 0); }
+	const uint32_t* pixels_end(size_t map_index) const { return pixel_offsets.data() + pixel_end[map_index]; }
+
+private:
+	static_assert(GLOBE_PIXEL_PAIR_COUNT * 2 <= 0xffff, "pixel_end is 16 bit");
+
+	std::vector<uint16_t> pixel_end;     // MAP_BIN_SIZE + 1, where the pixels of a byte end in pixel_offsets
+	std::vector<uint32_t> pixel_offsets; // grouped by map byte
+	std::vector<std::pair<uint32_t, uint32_t>> pixels; // scratch: map byte, framebuffer offset
+};
+
+/*
+ *  The geometry of the last capacity() tilts, least recently used goes first.
+ *  One tilt is GLOBE_PIXEL_PAIR_COUNT * 8 bytes (~44 KB).
+ */
+class globe_geometry_cache_t
+{
+public:
+	explicit globe_geometry_cache_t(unsigned capacity);
+
+	void set_capacity(unsigned capacity);
+	unsigned capacity() const { return max_entries; }
+
+	// nullptr if the tilt class is not cached
+	const globe_geometry_t* find(int tilt_class);
+	// builds the geometry, evicts the least recently used tilt if the cache is full
+	const globe_geometry_t& insert(int tilt_class);
+
+	// bytes held by the cached geometry
+	size_t memory_size() const;
+
+	uint64_t hits() const { return hit_count; }
+	uint64_t misses() const { return miss_count; }
+
+private:
+	struct entry_t
+	{
+		int tilt_class;
+		uint64_t last_use;
+		globe_geometry_t geometry;
+	};
+
+	std::vector<entry_t> entries;
+	unsigned max_entries;
+	uint64_t use_counter = 0;
+	uint64_t hit_count = 0;
+	uint64_t miss_count = 0;
+};
@@ -0,0 +1,192 @@
+#pragma once
+
+// Row kernels for draw_rows, shared by globe_renderer.cpp and globe_simd.cpp
+
+#include "globe_renderer.h"
+
+constexpr int MAP_CENTER_OFS = 0x62FC; // middle?
+
+/*
+ *  globe_tilt_lookup_table entries decoded for the kernels:
+ *    bits 0-7: offset1 (abs of the low byte)
+ *    bit 8   : low byte < 0  (gd = unk1 - table1 value)
+ *    bit 9   : entry < 0     (grlt_0 = -unk0)
+ */
+constexpr int32_t TILT_LO_NEGATIVE = 0x100;
+constexpr int32_t TILT_NEGATIVE = 0x200;
+
+using kernel_tilt_table_t = std::array<int32_t, MAX_TILT*2>;
+
+inline
+int32_t decode_tilt_entry(uint16_t value)
+{
+	const int8_t lo_ofs1 = int8_t(value & 0xff);
+	const int32_t offset1 = (lo_ofs1 < 0) ? -lo_ofs1 : lo_ofs1;
+	return offset1
+		| ((lo_ofs1 < 0) ? TILT_LO_NEGATIVE : 0)
+		| ((int16_t(value) < 0) ? TILT_NEGATIVE : 0);
+}
+
+/*
+ *  MAP.BIN is 2 * MAX_TILT + 1 latitude rings, ring r (kernel_map_ring) is the 2 * unk1
+ *  bytes from offset +-unk0 of its rotation table entry, func1 always picks a column
+ *  inside the ring. Neighbouring globe pixels are often in neighbouring rings, ~400
+ *  bytes apart in MAP.BIN. TILED keeps 8 neighbouring rings in one band of 64 byte
+ *  tiles, 8 columns of each ring per tile, so they share cache lines.
+ */
+constexpr int MAP_RING_COUNT = MAX_TILT * 2 + 1;
+constexpr int MAP_TILE_RINGS = 8;
+constexpr int MAP_TILE_COLUMNS = 8;
+constexpr int MAP_TILE_SIZE = MAP_TILE_RINGS * MAP_TILE_COLUMNS;
+
+// negative: grlt_0 = -unk0, entry 0 is the same ring either way
+inline constexpr
+int kernel_map_ring(int entry_index, bool negative)
+{
+	return MAX_TILT + (negative ? -entry_index : entry_index);
+}
+
+/*
+ *  The map in the globe_map_format_t layouts, the kernels read the one they are
+ *  instantiated for. Map offsets are relative to MAP_CENTER_OFS.
+ *  The planes are padded, the AVX2 gathers read 3 bytes past the wanted one. raw is
+ *  the map as loaded (MAP.BIN has no padding), its gather reads the RAW_MAP_GATHER_BACK
+ *  bytes before the wanted one instead.
+ */
+constexpr int RAW_MAP_GATHER_BACK = 3;
+
+struct kernel_map_t
+{
+	const uint8_t* raw;         // RAW: &globe_assets().map[MAP_CENTER_OFS]
+	const uint8_t* colored;     // COLORED: kernel_pixel_color of every map byte, same offsets
+	const uint8_t* nibbles;     // PACKED: map byte i (= offset + MAP_CENTER_OFS) in nibble i
+	const uint8_t* overlay;     // PACKED: bit i & 7 of byte i >> 3
+	const uint8_t* tiled;       // TILED: the COLORED bytes, see kernel_tiled_map_index
+	const int32_t* ring_tiles;  // TILED: MAP_RING_COUNT, where the first tile row of a ring starts
+};
+
+// where TILED keeps column of ring
+inline
+int kernel_tiled_map_index(const int32_t* ring_tiles, int ring, int column)
+{
+	// column >= 0, unsigned to get shifts
+	return ring_tiles[ring] + int(unsigned(column) / MAP_TILE_COLUMNS * MAP_TILE_SIZE + unsigned(column) % MAP_TILE_COLUMNS);
+}
+
+struct kernel_tables_t
+{
+	const int32_t* tilt;                            // kernel_tilt_table_t
+	const uint16_t* slice_values;                   // globe_program_t::slice_values
+	const rotation_lookup_table_entry_t* rotation;
+	kernel_map_t map;
+};
+
+inline constexpr
+uint8_t kernel_pixel_color(uint8_t value)
+{
+	uint8_t color = value & 0x0f;
+	if (((value & 0x30) == 0x10) && (color < 8)) {
+		color += 12;
+	}
+	return color + 0x10;
+}
+
+// the COLORED, PACKED and TILED planes of one map, globe_renderer_t builds them on demand
+struct kernel_map_planes_t
+{
+	explicit kernel_map_planes_t(const uint8_t* map);
+
+	kernel_map_t map(const uint8_t* raw_map) const;
+
+	// MAP.BIN byte map_index changed to value
+	void set(size_t map_index, uint8_t value);
+
+	std::vector<uint8_t> colored;
+	std::vector<uint8_t> nibbles;
+	std::vector<uint8_t> overlay;
+	std::vector<uint8_t> tiled;
+	std::array<int32_t, MAP_RING_COUNT> ring_tiles{};
+};
+
+// column of ring, which starts at map offset grlt_0. The linear formats only need the offset
+template<globe_map_format_t FORMAT>
+inline
+uint8_t kernel_map_color(const kernel_map_t& map, int ring, int grlt_0, int column)
+{
+	if constexpr (FORMAT == globe_map_format_t::TILED) {
+		return map.tiled[kernel_tiled_map_index(map.ring_tiles, ring, column)];
+	} else if constexpr (FORMAT == globe_map_format_t::COLORED) {
+		return map.colored[grlt_0 + column];
+	} else if constexpr (FORMAT == globe_map_format_t::PACKED) {
+		const int i = grlt_0 + column + MAP_CENTER_OFS;
+		const int color = (map.nibbles[i >> 1] >> ((i & 1) * 4)) & 0x0f;
+		const int overlay = (map.overlay[i >> 3] >> (i & 7)) & 1;
+		return uint8_t(0x10 + color + overlay * 12);
+	} else {
+		return kernel_pixel_color(map.raw[grlt_0 + column]);
+	}
+}
+
+// func1 without the per pixel checks: the ring, its map offset and the columns of both pixels
+struct kernel_pixel_pair_t
+{
+	int ring;
+	int grlt_0;
+	int left_column;
+	int right_column;
+};
+
+inline
+kernel_pixel_pair_t kernel_pixel_pair(const kernel_tables_t& kt, int index, int gd_val)
+{
+	const int32_t tilt = kt.tilt[MAX_TILT + gd_val];
+	const int offset1 = tilt & 0xff;
+	const uint16_t slice_value = kt.slice_values[index * SLICE_VALUE_COUNT + offset1];
+
+	const int entry_index = slice_value & 0xff;
+	const auto& entry = kt.rotation[entry_index];
+	const int table1 = slice_value >> 8;
+
+	const int ring = kernel_map_ring(entry_index, (tilt & TILT_NEGATIVE) != 0);
+	const int grlt_0 = (tilt & TILT_NEGATIVE) ? -entry.unk0 : entry.unk0;
+	const int gd = (tilt & TILT_LO_NEGATIVE) ? entry.unk1 - table1 : table1;
+	const int grlt_1 = entry.unk1 * 2;
+
+	int left_ofs = entry.fp_hi - gd;
+	if (left_ofs < 0) {
+		left_ofs += grlt_1;
+	}
+	int right_ofs = entry.fp_hi + gd - grlt_1;
+	if (right_ofs < 0) {
+		right_ofs += grlt_1;
+	}
+	return { ring, grlt_0, left_ofs, right_ofs };
+}
+
+// func2 without the per pixel checks, for the scalar kernel and the row tails of the SIMD kernels
+template<globe_map_format_t FORMAT>
+inline
+void kernel_draw_pixel_pair(const kernel_tables_t& kt, int index, int gd_val, uint8_t* left, uint8_t* right)
+{
+	const kernel_pixel_pair_t pair = kernel_pixel_pair(kt, index, gd_val);
+	*left = kernel_map_color<FORMAT>(kt.map, pair.ring, pair.grlt_0, pair.left_column);
+	*right = kernel_map_color<FORMAT>(kt.map, pair.ring, pair.grlt_0, pair.right_column);
+}
+
+/*
+ *  Draws one program row: gd_vals[0..count) from the center outwards,
+ *  left pixels at left[0], left[-1], ..., right pixels at right[0], right[1], ...
+ */
+using row_kernel_t = void (*)(const kernel_tables_t& kt, const int8_t* gd_vals, int count, uint8_t* left, uint8_t* right);
+
+template<globe_map_format_t FORMAT>
+inline
+void draw_row_scalar(const kernel_tables_t& kt, const int8_t* gd_vals, int count, uint8_t* left, uint8_t* right)
+{
+	for (int index = 0; index < count; ++index) {
+		kernel_draw_pixel_pair<FORMAT>(kt, index, gd_vals[index], left - index, right + index);
+	}
+}
+
+// nullptr if the kernel is not compiled in
+row_kernel_t simd_row_kernel(globe_kernel_t kernel, globe_map_format_t map_format);
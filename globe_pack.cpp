@@ -0,0 +1,105 @@
+// Writes ASSETS.PACK.inc, the embedded assets of the GLOBE_COMPRESSED_ASSETS build, no SDL needed:
+//   g++ -O2 -std=c++17 globe_pack.cpp globe_asset_codec.cpp globe_assets.cpp -o globe_pack
+//
+//   ./globe_pack [ASSETS.PACK.inc]
+//
+// Packs the four assets of the uncompressed build (the .BIN.inc files) back to back, checks that
+// they unpack again and prints the sizes next to the time unpacking them takes.
+
+#include "globe_assets.h"
+#include "globe_asset_codec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef GLOBE_COMPRESSED_ASSETS
+#error "globe_pack reads the uncompressed assets, build it without GLOBE_COMPRESSED_ASSETS"
+#endif
+
+namespace {
+
+struct asset_t
+{
+	const char* name;
+	const uint8_t* data;
+	size_t size;
+};
+
+bool write_inc(const char* path, const std::vector<uint8_t>& packed)
+{
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		fprintf(stderr, "can't write %s\n", path);
+		return false;
+	}
+
+	fprintf(file, "// written by globe_pack from GLOBDATA.BIN, MAP.BIN, PAL.BIN and TABLAT.BIN (%zu bytes), don't edit\n", GLOBE_ASSETS_SIZE);
+	fprintf(file, "const unsigned char GLOBE_ASSETS_PACK[] = {\n");
+	for (size_t i = 0; i < packed.size(); i += 12) {
+		fprintf(file, " ");
+		for (size_t k = i; k < std::min(i + 12, packed.size()); ++k) {
+			fprintf(file, " 0x%02x,", packed[k]);
+		}
+		fprintf(file, "\n");
+	}
+	fprintf(file, "};\n");
+
+	const bool ok = ferror(file) == 0;
+	fclose(file);
+	if (!ok) {
+		fprintf(stderr, "can't write %s\n", path);
+	}
+	return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	if (argc > 2) {
+		fprintf(stderr, "usage: %s [ASSETS.PACK.inc]\n", argv[0]);
+		return 1;
+	}
+	const char* path = argc == 2 ? argv[1] : "ASSETS.PACK.inc";
+
+	const asset_t assets[] = {
+		{ "GLOBDATA.BIN", GLOBDATA_BIN, GLOBDATA_BIN_SIZE },
+		{ "MAP.BIN", MAP_BIN, MAP_BIN_SIZE },
+		{ "PAL.BIN", PAL_BIN, PAL_BIN_SIZE },
+		{ "TABLAT.BIN", TABLAT_BIN, TABLAT_BIN_SIZE },
+	};
+
+	// in the order globe_assets.cpp expects them
+	std::vector<uint8_t> all;
+	for (const asset_t& asset : assets) {
+		all.insert(all.end(), asset.data, asset.data + asset.size);
+
+		// alone, only for the report
+		const size_t packed_size = pack_assets(asset.data, asset.size).size();
+		printf("%-14s %6zu -> %6zu bytes (%5.1f%%)\n", asset.name, asset.size, packed_size, 100.0 * packed_size / asset.size);
+	}
+
+	const std::vector<uint8_t> packed = pack_assets(all.data(), all.size());
+
+	// the startup cost, best of a few runs
+	std::vector<uint8_t> unpacked(all.size());
+	double decode_ms = 0;
+	for (int run = 0; run != 20; ++run) {
+		const auto start = std::chrono::steady_clock::now();
+		unpack_assets(packed.data(), packed.size(), unpacked.data(), unpacked.size());
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		decode_ms = run == 0 ? ms : std::min(decode_ms, ms);
+	}
+	if (unpacked != all) {
+		fprintf(stderr, "the packed assets don't unpack to the assets\n");
+		return 2;
+	}
+
+	printf("%-14s %6zu -> %6zu bytes (%5.1f%%), %zu bytes saved, unpacking takes %.2f ms\n",
+		"all", all.size(), packed.size(), 100.0 * packed.size() / all.size(), all.size() - packed.size(), decode_ms);
+
+	return write_inc(path, packed) ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+#include "globe_pipeline.h"
+
+globe_pipeline_t::globe_pipeline_t(globe_renderer_t& renderer)
+	: renderer(renderer)
+{
+	for (auto& buffer : buffers) {
+		buffer.pixels.resize(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT);
+	}
+
+	thread = std::thread(&globe_pipeline_t::render_main, this);
+}
+
+globe_pipeline_t::~globe_pipeline_t()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	wake.notify_one();
+
+	thread.join();
+}
+
+void globe_pipeline_t::request(int16_t tilt, uint16_t rotation, uint64_t sequence)
+{
+	++request_count;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (pose_pending) {
+			++superseded_count;
+		}
+		pose_pending = true;
+		pending_tilt = tilt;
+		pending_rotation = rotation;
+		pending_sequence = sequence;
+	}
+	wake.notify_one();
+}
+
+bool globe_pipeline_t::acquire(frame_t& frame)
+{
+	if (failed.load()) {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::rethrow_exception(error);
+	}
+
+	if (!(ready.load(std::memory_order_acquire) & FRESH)) {
+		return false;
+	}
+
+	front = ready.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+	++acquired_count;
+
+	const buffer_t& buffer = buffers[front];
+	frame = frame_t{ buffer.pixels.data(), buffer.tilt, buffer.rotation, buffer.sequence, buffer.generation };
+	return true;
+}
+
+bool globe_pipeline_t::idle() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return !pose_pending && !rendering && !(ready.load() & FRESH);
+}
+
+globe_pipeline_t::stats_t globe_pipeline_t::stats() const
+{
+	stats_t stats{};
+	stats.requests = request_count;
+	stats.superseded = superseded_count;
+	stats.rendered = rendered_count;
+	stats.acquired = acquired_count;
+	stats.dropped = dropped_count;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.pending_poses = pose_pending ? 1 : 0;
+	}
+	stats.ready_frames = (ready.load() & FRESH) ? 1 : 0;
+	return stats;
+}
+
+void globe_pipeline_t::render_main()
+{
+	try {
+		render_loop();
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> lock(mutex);
+		error = std::current_exception();
+		failed = true;
+	}
+}
+
+void globe_pipeline_t::render_loop()
+{
+	bool rendered_any = false;
+	globe_pose_t rendered_pose{};
+	unsigned rendered_generation = 0; // globe_assets().generation
+
+	while (true) {
+		int16_t tilt;
+		uint16_t rotation;
+		uint64_t sequence;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stop || pose_pending; });
+			if (stop) {
+				return;
+			}
+			tilt = pending_tilt;
+			rotation = pending_rotation;
+			sequence = pending_sequence;
+			pose_pending = false;
+			rendering = true;
+		}
+
+		// the newest frame already shows this pose
+		const globe_pose_t pose = canonical_globe_pose(tilt, rotation);
+		const unsigned generation = globe_assets().generation;
+		if (rendered_any && pose == rendered_pose && generation == rendered_generation) {
+			std::lock_guard<std::mutex> lock(mutex);
+			rendering = false;
+			continue;
+		}
+
+		buffer_t& buffer = buffers[back];
+		renderer.render(tilt, rotation, buffer.pixels.data());
+		buffer.tilt = tilt;
+		buffer.rotation = rotation;
+		buffer.sequence = sequence;
+		// the assets can be reloaded while the frame is drawn, render() uses one generation
+		buffer.generation = renderer.assets_generation();
+
+		rendered_any = true;
+		rendered_pose = pose;
+		rendered_generation = generation;
+		++rendered_count;
+
+		const int previous = ready.exchange(back | FRESH, std::memory_order_acq_rel);
+		if (previous & FRESH) {
+			++dropped_count;
+		}
+		back = previous & INDEX_MASK;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		rendering = false;
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "globe_renderer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+/*
+ *  Renders on its own thread into a triple buffered ring of 8-bit frames, so a slow
+ *  present does not hold up the next render and the other way round.
+ *  Poses and frames are both "latest wins": a requested pose that was not rendered
+ *  yet is replaced by a newer request, a rendered frame that was not acquired yet
+ *  is replaced by a newer frame.
+ *  request() and acquire() are meant to be called from one (the presenting) thread.
+ */
+class globe_pipeline_t
+{
+public:
+	struct frame_t
+	{
+		const uint8_t* pixels; // FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT, valid until the next acquire()
+		int16_t tilt;
+		uint16_t rotation;
+		uint64_t sequence; // as passed to request()
+		unsigned generation; // globe_assets().generation the frame was drawn with
+	};
+
+	struct stats_t
+	{
+		uint64_t requests;   // request() calls
+		uint64_t superseded; // poses replaced by a newer request before they were rendered
+		uint64_t rendered;
+		uint64_t acquired;
+		uint64_t dropped;    // frames replaced by a newer frame before they were acquired
+		int pending_poses;   // queue depth before the render stage (0 or 1)
+		int ready_frames;    // queue depth before the present stage (0 or 1)
+	};
+
+	// the renderer is used by the render thread only, until the pipeline is destroyed
+	explicit globe_pipeline_t(globe_renderer_t& renderer);
+	~globe_pipeline_t();
+
+	globe_pipeline_t(const globe_pipeline_t&) = delete;
+	globe_pipeline_t& operator=(const globe_pipeline_t&) = delete;
+
+	// sequence: the caller's tag for the pose, comes back with its frame
+	void request(int16_t tilt, uint16_t rotation, uint64_t sequence = 0);
+
+	// the newest rendered frame, false if there is none since the last acquire().
+	// An exception thrown by the renderer is rethrown here
+	bool acquire(frame_t& frame);
+
+	// true: no pose waiting or being rendered and no frame to acquire
+	bool idle() const;
+
+	stats_t stats() const;
+
+private:
+	void render_main();
+	void render_loop();
+
+	struct buffer_t
+	{
+		std::vector<uint8_t> pixels;
+		int16_t tilt = 0;
+		uint16_t rotation = 0;
+		uint64_t sequence = 0;
+		unsigned generation = 0;
+	};
+
+	// ready: index of the newest finished buffer, | FRESH if it was not acquired yet
+	static constexpr int INDEX_MASK = 3;
+	static constexpr int FRESH = 4;
+
+	globe_renderer_t& renderer;
+
+	std::array<buffer_t, 3> buffers;
+	std::atomic<int> ready{ 1 };
+	int back = 0;  // render thread
+	int front = 2; // acquire()
+
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	bool pose_pending = false;
+	int16_t pending_tilt = 0;
+	uint16_t pending_rotation = 0;
+	uint64_t pending_sequence = 0;
+	bool rendering = false;
+	bool stop = false;
+	std::exception_ptr error;
+	std::atomic<bool> failed{ false };
+
+	std::atomic<uint64_t> request_count{ 0 };
+	std::atomic<uint64_t> superseded_count{ 0 };
+	std::atomic<uint64_t> rendered_count{ 0 };
+	std::atomic<uint64_t> acquired_count{ 0 };
+	std::atomic<uint64_t> dropped_count{ 0 };
+
+	std::thread thread;
+};
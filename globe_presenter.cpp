@@ -0,0 +1,224 @@
+#include "globe_presenter.h"
+
+#include <cstring>
+#include <iterator>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define PRESENTER_SSE2 1
+#include <emmintrin.h>
+#else
+#define PRESENTER_SSE2 0
+#endif
+
+namespace {
+
+using expand_row_t = void (*)(const uint32_t* palette, const uint8_t* src, int width, uint32_t* dst);
+
+#if PRESENTER_SSE2
+
+// dst pixels 4*K .. 4*K+3 of 4 source pixels scaled by FACTOR
+template<int FACTOR, int K>
+inline
+void store_expanded(__m128i colors, uint32_t* dst)
+{
+	constexpr int i0 = (4*K + 0) / FACTOR;
+	constexpr int i1 = (4*K + 1) / FACTOR;
+	constexpr int i2 = (4*K + 2) / FACTOR;
+	constexpr int i3 = (4*K + 3) / FACTOR;
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4*K), _mm_shuffle_epi32(colors, _MM_SHUFFLE(i3, i2, i1, i0)));
+
+	if constexpr (K + 1 < FACTOR) {
+		store_expanded<FACTOR, K + 1>(colors, dst);
+	}
+}
+
+// width has to be a multiple of 4
+template<int FACTOR>
+void expand_row(const uint32_t* palette, const uint8_t* src, int width, uint32_t* dst)
+{
+	for (int x = 0; x < width; x += 4) {
+		const __m128i colors = _mm_setr_epi32(
+			int(palette[src[x + 0]]),
+			int(palette[src[x + 1]]),
+			int(palette[src[x + 2]]),
+			int(palette[src[x + 3]]));
+		store_expanded<FACTOR, 0>(colors, dst + x * FACTOR);
+	}
+}
+
+#else
+
+template<int FACTOR>
+void expand_row(const uint32_t* palette, const uint8_t* src, int width, uint32_t* dst)
+{
+	for (int x = 0; x < width; ++x) {
+		const uint32_t color = palette[src[x]];
+		for (int i = 0; i < FACTOR; ++i) {
+			dst[x * FACTOR + i] = color;
+		}
+	}
+}
+
+#endif
+
+// factors above 8
+void expand_row_any(const uint32_t* palette, const uint8_t* src, int width, int factor, uint32_t* dst)
+{
+	for (int x = 0; x < width; ++x) {
+		const uint32_t color = palette[src[x]];
+		for (int i = 0; i < factor; ++i) {
+			dst[x * factor + i] = color;
+		}
+	}
+}
+
+constexpr expand_row_t EXPAND_ROW[] = {
+	nullptr,
+	expand_row<1>, expand_row<2>, expand_row<3>, expand_row<4>,
+	expand_row<5>, expand_row<6>, expand_row<7>, expand_row<8>,
+};
+
+using expand_row_indexed_t = void (*)(const uint8_t* src, int width, uint8_t* dst);
+
+// one FACTOR byte store per source pixel
+template<int FACTOR>
+void expand_row_indexed(const uint8_t* src, int width, uint8_t* dst)
+{
+	for (int x = 0; x < width; ++x) {
+		const uint64_t bytes = src[x] * 0x0101010101010101ull;
+		memcpy(dst + x * FACTOR, &bytes, FACTOR);
+	}
+}
+
+#if PRESENTER_SSE2
+
+// 16 source pixels at a time, every unpack doubles the pixels
+template<>
+void expand_row_indexed<2>(const uint8_t* src, int width, uint8_t* dst)
+{
+	for (int x = 0; x < width; x += 16) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+		__m128i* out = reinterpret_cast<__m128i*>(dst + x * 2);
+		_mm_storeu_si128(out + 0, _mm_unpacklo_epi8(v, v));
+		_mm_storeu_si128(out + 1, _mm_unpackhi_epi8(v, v));
+	}
+}
+
+template<>
+void expand_row_indexed<4>(const uint8_t* src, int width, uint8_t* dst)
+{
+	for (int x = 0; x < width; x += 16) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+		const __m128i lo = _mm_unpacklo_epi8(v, v);
+		const __m128i hi = _mm_unpackhi_epi8(v, v);
+		__m128i* out = reinterpret_cast<__m128i*>(dst + x * 4);
+		_mm_storeu_si128(out + 0, _mm_unpacklo_epi16(lo, lo));
+		_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, lo));
+		_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, hi));
+		_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, hi));
+	}
+}
+
+template<>
+void expand_row_indexed<8>(const uint8_t* src, int width, uint8_t* dst)
+{
+	for (int x = 0; x < width; x += 16) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+		const __m128i lo = _mm_unpacklo_epi8(v, v);
+		const __m128i hi = _mm_unpackhi_epi8(v, v);
+		const __m128i quads[4] = {
+			_mm_unpacklo_epi16(lo, lo), _mm_unpackhi_epi16(lo, lo),
+			_mm_unpacklo_epi16(hi, hi), _mm_unpackhi_epi16(hi, hi),
+		};
+		__m128i* out = reinterpret_cast<__m128i*>(dst + x * 8);
+		for (int i = 0; i != 4; ++i) {
+			_mm_storeu_si128(out + 2*i + 0, _mm_unpacklo_epi32(quads[i], quads[i]));
+			_mm_storeu_si128(out + 2*i + 1, _mm_unpackhi_epi32(quads[i], quads[i]));
+		}
+	}
+}
+
+#endif
+
+constexpr expand_row_indexed_t EXPAND_ROW_INDEXED[] = {
+	nullptr,
+	expand_row_indexed<1>, expand_row_indexed<2>, expand_row_indexed<3>, expand_row_indexed<4>,
+	expand_row_indexed<5>, expand_row_indexed<6>, expand_row_indexed<7>, expand_row_indexed<8>,
+};
+
+}
+
+namespace {
+
+// rect widened to multiples of 16 pixels in x for the row expansion, clipped to the framebuffer
+framebuffer_rect_t expansion_rect(const framebuffer_rect_t& rect)
+{
+	static_assert((FRAMEBUFFER_WIDTH % 16) == 0, "the row expansion needs multiples of 16");
+
+	const int x0 = (rect.x < 0) ? 0 : (rect.x & ~15);
+	const int x1 = (rect.x + rect.w > FRAMEBUFFER_WIDTH) ? FRAMEBUFFER_WIDTH : ((rect.x + rect.w + 15) & ~15);
+	const int y0 = (rect.y < 0) ? 0 : rect.y;
+	const int y1 = (rect.y + rect.h > FRAMEBUFFER_HEIGHT) ? FRAMEBUFFER_HEIGHT : rect.y + rect.h;
+	return { x0, y0, (x1 > x0) ? x1 - x0 : 0, (y1 > y0) ? y1 - y0 : 0 };
+}
+
+}
+
+framebuffer_rect_t globe_presenter_t::present(const uint8_t* framebuffer, int factor, uint8_t* dst, int dst_pitch, const framebuffer_rect_t& rect) const
+{
+	assert_throw(factor >= 1);
+	assert_throw(dst_pitch >= FRAMEBUFFER_WIDTH * factor * 4);
+
+	const framebuffer_rect_t r = expansion_rect(rect);
+	const size_t row_size = size_t(r.w) * factor * 4;
+	const expand_row_t expand = (factor < int(std::size(EXPAND_ROW))) ? EXPAND_ROW[factor] : nullptr;
+
+	for (int y = r.y; y < r.y + r.h; ++y) {
+		const uint8_t* src = &framebuffer[y * FRAMEBUFFER_WIDTH + r.x];
+		uint8_t* line = &dst[size_t(y) * factor * dst_pitch + size_t(r.x) * factor * 4];
+
+		if (expand) {
+			expand(palette.data(), src, r.w, reinterpret_cast<uint32_t*>(line));
+		} else {
+			expand_row_any(palette.data(), src, r.w, factor, reinterpret_cast<uint32_t*>(line));
+		}
+
+		for (int i = 1; i < factor; ++i) {
+			memcpy(line + size_t(i) * dst_pitch, line, row_size);
+		}
+	}
+
+	return r;
+}
+
+framebuffer_rect_t globe_presenter_t::present_indexed(const uint8_t* framebuffer, int factor, uint8_t* dst, int dst_pitch, const framebuffer_rect_t& rect) const
+{
+	assert_throw(factor >= 1);
+	assert_throw(dst_pitch >= FRAMEBUFFER_WIDTH * factor);
+
+	const framebuffer_rect_t r = expansion_rect(rect);
+	const size_t row_size = size_t(r.w) * factor;
+	const expand_row_indexed_t expand = (factor < int(std::size(EXPAND_ROW_INDEXED))) ? EXPAND_ROW_INDEXED[factor] : nullptr;
+
+	for (int y = r.y; y < r.y + r.h; ++y) {
+		const uint8_t* src = &framebuffer[y * FRAMEBUFFER_WIDTH + r.x];
+		uint8_t* line = &dst[size_t(y) * factor * dst_pitch + size_t(r.x) * factor];
+
+		if (factor == 1) {
+			memcpy(line, src, r.w);
+		} else if (expand) {
+			expand(src, r.w, line);
+		} else {
+			for (int x = 0; x < r.w; ++x) {
+				memset(line + x * factor, src[x], factor);
+			}
+		}
+
+		for (int i = 1; i < factor; ++i) {
+			memcpy(line + size_t(i) * dst_pitch, line, row_size);
+		}
+	}
+
+	return r;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "globe_renderer.h"
+
+// 32 bit pixel of every palette index, already in the pixel format of the target surface
+using presenter_palette_t = std::array<uint32_t, 256>;
+
+/*
+ *  Presentation stage: palette lookup and scaling of the 8-bit framebuffer into a
+ *  32 bit surface, or just the scaling into an 8-bit (paletted) surface.
+ *  Every source row is expanded once (specialized for the factors 1-8, SIMD for
+ *  32 bit) and then copied to the other factor - 1 lines with memcpy.
+ *  No SDL dependency, the caller builds the palette (e.g. with SDL_MapRGB).
+ */
+class globe_presenter_t
+{
+public:
+	void set_palette(const presenter_palette_t& palette) { this->palette = palette; }
+	const presenter_palette_t& current_palette() const { return palette; }
+
+	// framebuffer: FRAMEBUFFER_WIDTH x FRAMEBUFFER_HEIGHT palette indices,
+	// dst: FRAMEBUFFER_HEIGHT * factor lines of dst_pitch bytes, FRAMEBUFFER_WIDTH * factor 32 bit pixels each.
+	// Only rect (in framebuffer pixels) is presented, widened to multiples of 16 pixels in x,
+	// returns the rect that was written
+	framebuffer_rect_t present(const uint8_t* framebuffer, int factor, uint8_t* dst, int dst_pitch, const framebuffer_rect_t& rect = FRAMEBUFFER_RECT) const;
+
+	// same for an 8-bit surface, the palette indices are copied as they are
+	framebuffer_rect_t present_indexed(const uint8_t* framebuffer, int factor, uint8_t* dst, int dst_pitch, const framebuffer_rect_t& rect = FRAMEBUFFER_RECT) const;
+
+private:
+	presenter_palette_t palette{};
+};
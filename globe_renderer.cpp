@@ -0,0 +1,1145 @@
+#include "globe_renderer.h"
+#include "globe_frame_cache.h"
+#include "globe_geometry.h"
+#include "globe_kernel.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+
+// constexpr copies for the compile time decoding, never used at runtime
+namespace constexpr_assets {
+constexpr
+#include "GLOBDATA.BIN.inc"
+constexpr
+#include "TABLAT.BIN.inc"
+}
+
+static_assert(sizeof(GLOBDATA_BIN_t) == sizeof(constexpr_assets::GLOBDATA_BIN),"wrong size");
+
+inline
+uint16_t hi(uint32_t v) {
+	return (v >> 16) & 0xffff;
+}
+
+inline
+uint16_t lo(uint32_t v) {
+	return (v >> 0) & 0xffff;
+}
+
+inline
+int8_t hi(int16_t v) {
+	return v >> 8;
+}
+
+inline
+int8_t lo(int16_t v) {
+	return v & 0xff;
+}
+
+/*
+ *  globe_rotation is value from 0x0000 - 0xffff.
+ *  Think of it as the fractional part of a 16.16 fixed point number.
+ */
+void precalculate_globe_rotation_lookup_table(globe_rotation_lookup_table_t& rotation_lookup_table, uint16_t globe_rotation) {
+	constexpr uint32_t MAGIC_VALUE = GLOBE_ROTATION_CLASS_COUNT; // (200-1)*2?
+
+	uint32_t dxax = globe_rotation * MAGIC_VALUE;
+
+	// Floor the 16.16 fp value
+	dxax &= ~0xffff;
+	// same as dxax &= 0xFFFFFFFFFFFF0000;
+
+	auto& first = rotation_lookup_table[0];
+
+	assert_throw(first.unk0 == 0);
+	assert_throw(first.unk1 != 0);
+	first.fp_hi = hi(dxax);
+	first.fp_lo = lo(dxax);
+
+	// Add 0.5 in 16.16 fixed point
+	dxax += 0x8000;
+
+	// Convert back to value from 0-1 in 16.16 fixed point
+	uint16_t bx = dxax / MAGIC_VALUE;
+
+	for (int i = 1; i != MAX_TILT+1; ++i) {
+		auto& entry = rotation_lookup_table[i];
+
+		assert_throw(entry.unk0 != 0); // meaning?
+		uint32_t dxax = 2 * uint32_t(bx) * uint32_t(entry.unk1);
+		entry.fp_hi = hi(dxax);
+		entry.fp_lo = lo(dxax);
+	}
+}
+
+inline constexpr
+int16_t clamp(int16_t value, int16_t min, int16_t max)
+{
+	// with C++17: std::clamp
+	if (value < min) {
+		return min;
+	}
+	if (value > max) {
+		return max;
+	}
+	return value;
+}
+
+constexpr
+void precalculate_globe_tilt_lookup_table(globe_tilt_lookup_table_t& tilt_lookup_table, int16_t globe_tilt) {
+	globe_tilt = clamp(globe_tilt, -MAX_TILT, MAX_TILT);
+
+	int i = 0;
+
+	// For stage 1, count down from globe_tilt-(MAX_TILT+1) to -MAX_TILT
+	if (globe_tilt > 0) {
+		int v = globe_tilt - MAX_TILT;
+		do {
+			tilt_lookup_table[i++] = uint8_t(--v);
+		} while (i != tilt_lookup_table.size() && v > -MAX_TILT);
+	}
+
+	if (i == tilt_lookup_table.size()) {
+		return;
+	}
+
+	// For stage 2, count down from MAX_TILT to 0
+	int v = globe_tilt + MAX_TILT - i;
+	do {
+		tilt_lookup_table[i++] = uint8_t(v--);
+	} while (i != tilt_lookup_table.size() && v >= 0);
+
+	if (i == tilt_lookup_table.size()) {
+		return;
+	}
+
+	// For stage 3, count up from 1 to MAX_TILT, binary-or'ed with 0xff00
+	v = 1;
+	do {
+		tilt_lookup_table[i++] = v++ | 0xff00;
+	} while (i != tilt_lookup_table.size() && v <= MAX_TILT);
+
+	if (i == tilt_lookup_table.size()) {
+		return;
+	}
+
+	// For stage 4, count up from -MAX_TILT to 0, binary-or'ed with 0xff00
+	v = -MAX_TILT;
+	do {
+		tilt_lookup_table[i++] = v++ | 0xff00;
+	} while (i != tilt_lookup_table.size() && v <= 0);
+}
+
+inline constexpr
+int frame_buffer_offset(int x, int y, int pitch) {
+	return y * pitch + x;
+}
+
+struct result_t
+{
+	int16_t gd{};
+	int16_t grlt_0{};
+	uint16_t grlt_1{};
+	uint16_t entry_fp_hi{};
+};
+
+result_t func1(const table_slices_t& tables, const globe_rotation_lookup_table_t& rotation_lookup_table, const int16_t ofs1) {
+	const int8_t lo_ofs1 = lo(ofs1);
+	assert_throw((lo_ofs1 >= -98) && (lo_ofs1 <= 98));
+
+	const int offset1 = (lo_ofs1 < 0) ? -lo_ofs1 : lo_ofs1;
+	assert_throw((offset1 >= 0) && (offset1 <= 98)); // 1,2,3,4,5,9,11,19,28,39,51,67,74,86,94,97,98
+
+	const uint8_t index_from_gd1 = tables.table0_slice.value[offset1];
+
+	//0,2,4,6,...,190,192,194,196 -> does not fit into int8_t
+	assert_throw((index_from_gd1 >= 0) && (index_from_gd1 <= 196) && ((index_from_gd1 % 2) == 0));
+
+	const auto& entry = rotation_lookup_table[index_from_gd1 / 2];
+	assert_throw((entry.unk0 >= 0) && (entry.unk0 <= 25334)); // signed: -25334 ... +25334
+	assert_throw((entry.unk1 >= 3) && (entry.unk1 <= 199));
+	assert_throw((entry.fp_hi >= 0) && (entry.fp_hi <= 397)); // 0,1,2,3,4,...,397
+
+	// ofs1 < 0 == hi & lo < 0?
+	const int16_t grlt_0 = (ofs1 < 0) ? -entry.unk0 : entry.unk0;
+	//with uint16_t
+	//assert((grlt_0 <= 65138) && ((grlt_0 % 2) == 0));
+	//with int16_t
+	assert_throw((grlt_0 >= -25334) && (grlt_0 <= 25334) && ((grlt_0 % 2) == 0));
+
+	const uint8_t index_from_gd2 = tables.table1_slice.value[offset1];
+	//accessors.access(&sub_globdata[MAGIC_200 / 2] - globdata_, 4);
+
+	//1,2,3,4,...,97,98,99 -> fits into int8_t
+	assert_throw(index_from_gd2 >= 0 && index_from_gd2 <= 99);
+
+	// (lo_ofs1 < 0) ? entry.unk1(3-199) - index_from_gd2(0..99) : index_from_gd2(0..99)
+	const int16_t gd = (lo_ofs1 < 0) ? entry.unk1 - index_from_gd2 : index_from_gd2;
+	assert_throw((gd >= 0) && (gd <= 195));
+
+	const uint16_t grlt_1 = entry.unk1 * 2;
+	assert_throw((grlt_1 >= 6) && (grlt_1 <= 398) && ((grlt_1 % 2) == 0));
+
+	return result_t{ gd, grlt_0, grlt_1, entry.fp_hi };
+};
+
+inline
+int color_map_offset(int16_t value, int16_t adjust1, int16_t adjust2) {
+	if (value < 0) {
+		value += adjust1;
+	}
+	value += adjust2;
+	return int(value);
+};
+
+uint8_t pixel_color(uint8_t value) {
+	//base color?
+	uint8_t color = value & 0x0f;
+
+	// this code is currently not in use
+	if ((value & 0x30) == 0x10) {
+		// overlay color?
+		if (color < 8) {
+			color += 12;
+		}
+	}
+
+	color += 0x10;
+	return color;
+};
+
+// sub_map: &map[MAP_CENTER_OFS]
+void set_pixel_color(const uint8_t* sub_map, uint8_t* framebuffer_pixel, int map_ofs)
+{
+	assert_throw((map_ofs >= -25334) && (map_ofs <= 25339));
+
+	*framebuffer_pixel = pixel_color(sub_map[map_ofs]);
+};
+
+struct draw_tables_t
+{
+	const globe_rotation_lookup_table_t& rotation_lookup_table;
+	const globe_tilt_lookup_table_t& tilt_lookup_table;
+	const std::array<table_slices_t, 64>& all_slices;
+
+	// nullptr: func2 per pixel
+	row_kernel_t row_kernel;
+	const kernel_tables_t& kt;
+};
+
+void func2(const draw_tables_t& dt, const table_slices_t& tables, const int8_t gd_val, uint8_t* left_side_globe_pixel, uint8_t* right_side_globe_pixel)
+{
+	// hi,lo int8 values?
+	const uint16_t some_value = dt.tilt_lookup_table[MAX_TILT + gd_val];
+	const result_t res = func1(tables, dt.rotation_lookup_table, some_value);
+
+	assert_throw((res.gd >= 0) && (res.gd <= 195));
+	assert_throw((res.grlt_0 >= -25334) && (res.grlt_0 <= 25334) && ((res.grlt_0 % 2) == 0));
+	assert_throw((res.grlt_1 >= 6) && (res.grlt_1 <= 398) && ((res.grlt_1 % 2) == 0));
+	assert_throw((res.entry_fp_hi >= 0) && (res.entry_fp_hi <= 397)); // 0,1,2,3,4,...,397
+
+	// left part of the globe
+	set_pixel_color(
+		dt.kt.map.raw,
+		left_side_globe_pixel,
+		color_map_offset(res.entry_fp_hi - res.gd,
+			res.grlt_1,
+			res.grlt_0)
+	);
+
+	// right part of the globe
+	set_pixel_color(
+		dt.kt.map.raw,
+		right_side_globe_pixel,
+		color_map_offset(res.entry_fp_hi + res.gd - res.grlt_1,
+			res.grlt_1,
+			res.grlt_0)
+	);
+};
+
+// a globe line in GLOBDATA_BIN_t::unk0
+struct globe_line_t
+{
+	int first{};
+	int count{};
+};
+
+using globe_lines_t = std::array<globe_line_t, GLOBE_LINE_COUNT>;
+
+constexpr
+globe_lines_t parse_globe_lines(const unsigned char* unk0)
+{
+#if 0
+// layout documentation
+#pragma pack(push,1)
+	struct unk0_t
+	{
+		int8_t first; // -65
+		std::array<int8_t, 2868> values; // n lines of (non negative)values ending with negative value (and a final -1 value)
+		// forming a globe contur
+		// v are indices to the globe_tilt_lookup_table
+			//v v v v v v [<0]
+			//v v v v v v v v v v v v [<0]
+			//v v v v v v v v v v v v v [<0]
+			//v v v v v v v v v v v v v v v [<0]
+			//v v v v v v v v v v v v v [<0]
+			//...
+			//v v v v v v v v v v [<0]
+			//-1
+		std::array<uint8_t, 421> unused; // all 0
+	};
+#pragma pack(pop)
+	static_assert(offsetof(unk0_t, unused) == 2869, "wrong offset");
+#endif
+
+	globe_lines_t lines{};
+	int line_count = 0;
+
+	int di = 1;
+
+	const int8_t val0 = int8_t(unk0[0]);
+	assert_throw(val0 == -65);
+
+	while (true)
+	{
+		assert_throw((di >= 1) && (di <= 2867));
+
+		int8_t val = int8_t(unk0[di++]);
+		if (val == -1)
+		{
+			break;
+		}
+
+		assert_throw(line_count < GLOBE_LINE_COUNT);
+		globe_line_t& line = lines[line_count++];
+		line.first = di - 1;
+		do
+		{
+			assert_throw(val >= 0);
+			++line.count;
+			val = int8_t(unk0[di++]);
+		} while (val >= 0);
+		assert_throw(line.count <= 64);
+	}
+
+	assert_throw(line_count == GLOBE_LINE_COUNT);
+	assert_throw(di == 2868);
+
+	for (int i = 2869; i < 3290; ++i)
+	{
+		assert_throw(unk0[i] == 0);
+	}
+
+	return lines;
+}
+
+struct point_t
+{
+	int x{};
+	int y{};
+};
+
+constexpr
+globe_program_t compile_globe_program(const unsigned char* globdata)
+{
+	const unsigned char* unk0 = &globdata[offsetof(GLOBDATA_BIN_t, unk0)];
+	const globe_lines_t globe_lines = parse_globe_lines(unk0);
+
+	globe_program_t program{};
+	int row_count = 0;
+	int pixel_count = 0;
+
+	const auto add_row = [&](const globe_line_t& line, point_t start_point, bool is_north) {
+		assert_throw(row_count < GLOBE_ROW_COUNT);
+		assert_throw(pixel_count + line.count <= GLOBE_PIXEL_PAIR_COUNT);
+		program.rows[row_count++] = { int16_t(start_point.x), int16_t(start_point.y), uint16_t(pixel_count), uint16_t(line.count) };
+		for (int i = 0; i != line.count; ++i) {
+			const int8_t gd_val = int8_t(unk0[line.first + i]);
+			program.gd_vals[pixel_count++] = is_north ? gd_val : int8_t(-gd_val);
+		}
+	};
+
+	// northern hemisphere: line 0 at y=79 upwards, drawn top to bottom
+	for (int gl = GLOBE_LINE_COUNT - 1; gl >= 0; --gl) {
+		add_row(globe_lines[gl], point_t{ 160, 80-1 - gl }, true);
+	}
+	// southern hemisphere: line 1 at y=80 downwards
+	for (int gl = 1; gl < GLOBE_LINE_COUNT; ++gl) {
+		add_row(globe_lines[gl], point_t{ 160, 80+0 + gl-1 }, false);
+	}
+
+	assert_throw(row_count == GLOBE_ROW_COUNT);
+	assert_throw(pixel_count == GLOBE_PIXEL_PAIR_COUNT);
+
+	for (int slice = 0; slice != 64; ++slice) {
+		const int slice_ofs = int(offsetof(GLOBDATA_BIN_t, all_slices) + slice * sizeof(table_slices_t));
+		for (int offset1 = 0; offset1 != SLICE_VALUE_COUNT; ++offset1) {
+			const uint8_t index_from_gd1 = globdata[slice_ofs + offsetof(table_slices_t, table0_slice) + offset1];
+			const uint8_t index_from_gd2 = globdata[slice_ofs + offsetof(table_slices_t, table1_slice) + offset1];
+			// the ranges func1 checks per pixel
+			assert_throw((index_from_gd1 <= 196) && ((index_from_gd1 % 2) == 0));
+			assert_throw(index_from_gd2 <= 99);
+			program.slice_values[slice * SLICE_VALUE_COUNT + offset1] = uint16_t((index_from_gd1 / 2) | (index_from_gd2 << 8));
+		}
+	}
+	program.slice_values.back() = 0;
+
+	return program;
+}
+
+constexpr
+globe_rotation_lookup_table_t decode_globe_rotation_lookup_table(const uint8_t* tablat)
+{
+	globe_rotation_lookup_table_t rotation_lookup_table{};
+
+	const auto u16 = [&](int ofs) {
+		return uint16_t(tablat[ofs] | (tablat[ofs + 1] << 8));
+	};
+
+	for (int i = 0; i != MAX_TILT+1; ++i) {
+		auto& entry = rotation_lookup_table[i];
+		entry.unk0 = u16(i * 8 + 0);
+		entry.unk1 = u16(i * 8 + 2);
+		entry.fp_hi = u16(i * 8 + 4);
+		entry.fp_lo = u16(i * 8 + 6);
+
+		// precalculate_globe_rotation_lookup_table and func1 rely on these
+		assert_throw((i == 0) ? (entry.unk0 == 0) : (entry.unk0 != 0));
+		assert_throw(entry.unk0 <= 25334);
+		assert_throw((entry.unk1 >= 3) && (entry.unk1 <= 199));
+	}
+
+	return rotation_lookup_table;
+}
+
+constexpr
+framebuffer_rect_t globe_program_bounding_rect(const globe_program_t& program)
+{
+	int x0 = FRAMEBUFFER_WIDTH;
+	int y0 = FRAMEBUFFER_HEIGHT;
+	int x1 = 0;
+	int y1 = 0;
+	for (const auto& row : program.rows) {
+		// pixel pair i goes to x-1-i and x+i
+		x0 = (row.x - row.count < x0) ? row.x - row.count : x0;
+		x1 = (row.x + row.count > x1) ? row.x + row.count : x1;
+		y0 = (row.y < y0) ? row.y : y0;
+		y1 = (row.y + 1 > y1) ? row.y + 1 : y1;
+	}
+	assert_throw((x0 >= 0) && (x1 <= FRAMEBUFFER_WIDTH) && (y0 >= 0) && (y1 <= FRAMEBUFFER_HEIGHT));
+	return { x0, y0, x1 - x0, y1 - y0 };
+}
+
+using globe_tilt_lookup_tables_t = std::array<globe_tilt_lookup_table_t, MAX_TILT*2+1>;
+
+constexpr
+globe_tilt_lookup_tables_t precalculate_all_globe_tilt_lookup_tables()
+{
+	globe_tilt_lookup_tables_t tilt_lookup_tables{};
+	for (int tilt = -MAX_TILT; tilt <= MAX_TILT; ++tilt) {
+		precalculate_globe_tilt_lookup_table(tilt_lookup_tables[MAX_TILT + tilt], int16_t(tilt));
+	}
+	return tilt_lookup_tables;
+}
+
+// a failed assert_throw in here is a compile error
+constexpr globe_program_t GLOBE_PROGRAM = compile_globe_program(constexpr_assets::GLOBDATA_BIN);
+constexpr globe_rotation_lookup_table_t BASE_GLOBE_ROTATION_LOOKUP_TABLE = decode_globe_rotation_lookup_table(constexpr_assets::TABLAT_BIN);
+constexpr globe_tilt_lookup_tables_t GLOBE_TILT_LOOKUP_TABLES = precalculate_all_globe_tilt_lookup_tables();
+constexpr framebuffer_rect_t GLOBE_BOUNDING_RECT = globe_program_bounding_rect(GLOBE_PROGRAM);
+
+// min/max of f - threshold over f in [lo, hi], with wrap added where f < threshold
+struct offset_range_t
+{
+	int min;
+	int max;
+};
+
+constexpr
+offset_range_t wrapped_offset_range(int lo, int hi, int threshold, int wrap)
+{
+	offset_range_t range{ 1 << 30, -(1 << 30) };
+	const auto add = [&](int a, int b) {
+		range.min = (a < range.min) ? a : range.min;
+		range.max = (b > range.max) ? b : range.max;
+	};
+	if (hi >= threshold) {
+		add(((lo > threshold) ? lo : threshold) - threshold, hi - threshold);
+	}
+	if (lo < threshold) {
+		add(lo - threshold + wrap, ((hi < threshold - 1) ? hi : threshold - 1) - threshold + wrap);
+	}
+	return range;
+}
+
+/*
+ *  Proves what func1, func2 and set_pixel_color check per pixel, for every pose:
+ *  the program only indexes the tilt tables in range, the tilt tables only hold offsets
+ *  0-98, and for every slice value a pixel can reach (with the signs it can reach it with)
+ *  the rotation table entry (for all rotations), gd, grlt_0, grlt_1 and both map offsets
+ *  are in range.
+ *  With this the kernels need no checks (globe_kernel_t::CHECKED still has them).
+ *  map_offset_min/max: the map offsets around MAP_CENTER_OFS that are inside MAP_BIN.
+ */
+constexpr
+bool validate_globe_tables(
+	const globe_program_t& program,
+	const globe_rotation_lookup_table_t& base_rotation_lookup_table,
+	const globe_tilt_lookup_tables_t& tilt_lookup_tables,
+	int map_offset_min,
+	int map_offset_max)
+{
+	// slices (pixel index in the row) that read tilt table entry [MAX_TILT + gd_val], as bit masks
+	std::array<uint64_t, MAX_TILT*2> entry_slices{};
+	for (const auto& row : program.rows) {
+		assert_throw(row.count <= 64);
+		for (int i = 0; i != row.count; ++i) {
+			const int gd_val = program.gd_vals[row.first_pixel + i];
+			assert_throw((gd_val >= -MAX_TILT) && (gd_val < MAX_TILT));
+			entry_slices[MAX_TILT + gd_val] |= uint64_t(1) << i;
+		}
+	}
+
+	// slices that can meet offset1 with the sign bits of a tilt entry (bit 0: low byte < 0, bit 1: entry < 0)
+	std::array<std::array<uint64_t, 4>, 99> reachable_slices{};
+	for (const auto& tilt_lookup_table : tilt_lookup_tables) {
+		for (int i = 0; i != tilt_lookup_table.size(); ++i) {
+			const uint16_t value = tilt_lookup_table[i];
+			const int lo_ofs1 = int8_t(value & 0xff);
+			assert_throw((lo_ofs1 >= -98) && (lo_ofs1 <= 98));
+			const int offset1 = (lo_ofs1 < 0) ? -lo_ofs1 : lo_ofs1;
+			const int signs = ((lo_ofs1 < 0) ? 1 : 0) | ((int16_t(value) < 0) ? 2 : 0);
+			reachable_slices[offset1][signs] |= entry_slices[i];
+		}
+	}
+
+	// fp_hi as precalculate_globe_rotation_lookup_table computes it, it grows with the rotation
+	// class, so the first and the last class bound it
+	const auto fp_hi = [](const rotation_lookup_table_entry_t& entry, int i, int rotation_class) {
+		const uint32_t dxax = uint32_t(rotation_class) << 16;
+		if (i == 0) {
+			return int(dxax >> 16);
+		}
+		const uint16_t bx = uint16_t((dxax + 0x8000) / GLOBE_ROTATION_CLASS_COUNT);
+		return int((2 * uint32_t(bx) * uint32_t(entry.unk1)) >> 16);
+	};
+
+	for (int slice = 0; slice != 64; ++slice) {
+		for (int offset1 = 0; offset1 <= 98; ++offset1) {
+			const auto& reachable = reachable_slices[offset1];
+			if (!((reachable[0] | reachable[1] | reachable[2] | reachable[3]) & (uint64_t(1) << slice))) {
+				continue;
+			}
+
+			const uint16_t slice_value = program.slice_values[slice * SLICE_VALUE_COUNT + offset1];
+			const int entry_index = slice_value & 0xff;
+			const int table1 = slice_value >> 8;
+			assert_throw((entry_index <= MAX_TILT) && (table1 <= 99));
+
+			const auto& entry = base_rotation_lookup_table[entry_index];
+			const int fp_hi_min = fp_hi(entry, entry_index, 0);
+			const int fp_hi_max = fp_hi(entry, entry_index, GLOBE_ROTATION_CLASS_COUNT - 1);
+			assert_throw((fp_hi_min >= 0) && (fp_hi_max <= 397));
+			assert_throw((entry.unk0 <= 25334) && (entry.unk1 >= 3) && (entry.unk1 <= 199));
+
+			const int grlt_1 = entry.unk1 * 2;
+
+			for (int signs = 0; signs != 4; ++signs) {
+				if (!(reachable[signs] & (uint64_t(1) << slice))) {
+					continue;
+				}
+
+				const int gd = (signs & 1) ? entry.unk1 - table1 : table1;
+				assert_throw((gd >= 0) && (gd <= 195));
+
+				// left: fp_hi - gd, right: fp_hi + gd - grlt_1, + grlt_1 when negative
+				const offset_range_t left = wrapped_offset_range(fp_hi_min, fp_hi_max, gd, grlt_1);
+				const offset_range_t right = wrapped_offset_range(fp_hi_min, fp_hi_max, grlt_1 - gd, grlt_1);
+				assert_throw((left.min >= 0) && (right.min >= 0));
+
+				const int grlt_0 = (signs & 2) ? -entry.unk0 : entry.unk0;
+				assert_throw((grlt_0 % 2) == 0);
+				assert_throw((grlt_0 + left.min >= -25334) && (grlt_0 + left.max <= 25339));
+				assert_throw((grlt_0 + right.min >= -25334) && (grlt_0 + right.max <= 25339));
+				assert_throw((grlt_0 + left.min >= map_offset_min) && (grlt_0 + left.max <= map_offset_max));
+				assert_throw((grlt_0 + right.min >= map_offset_min) && (grlt_0 + right.max <= map_offset_max));
+			}
+		}
+	}
+
+	return true;
+}
+
+// a failed assert_throw in here is a compile error, the unchecked kernels rely on it.
+// The AVX2 RAW gather also reads the RAW_MAP_GATHER_BACK bytes before every offset
+constexpr bool GLOBE_TABLES_VALIDATED = validate_globe_tables(GLOBE_PROGRAM, BASE_GLOBE_ROTATION_LOOKUP_TABLE,
+	GLOBE_TILT_LOOKUP_TABLES, RAW_MAP_GATHER_BACK - MAP_CENTER_OFS, int(MAP_BIN_SIZE) - 1 - MAP_CENTER_OFS);
+static_assert(GLOBE_TABLES_VALIDATED, "globe tables");
+
+const globe_program_t& globe_program()
+{
+	return GLOBE_PROGRAM;
+}
+
+const framebuffer_rect_t& globe_bounding_rect()
+{
+	return GLOBE_BOUNDING_RECT;
+}
+
+const globe_rotation_lookup_table_t& base_globe_rotation_lookup_table()
+{
+	return BASE_GLOBE_ROTATION_LOOKUP_TABLE;
+}
+
+const globe_tilt_lookup_table_t& globe_tilt_lookup_table(int16_t globe_tilt)
+{
+	return GLOBE_TILT_LOOKUP_TABLES[MAX_TILT + clamp(globe_tilt, -MAX_TILT, MAX_TILT)];
+}
+
+namespace {
+
+// the rotation table entry of map ring ring, see kernel_map_ring
+const rotation_lookup_table_entry_t& map_ring_entry(int ring)
+{
+	return BASE_GLOBE_ROTATION_LOOKUP_TABLE[(ring < MAX_TILT) ? MAX_TILT - ring : ring - MAX_TILT];
+}
+
+// the map offset every ring starts at, they go up with the ring
+constexpr std::array<int32_t, MAP_RING_COUNT> make_map_ring_offsets(const globe_rotation_lookup_table_t& rotation_lookup_table)
+{
+	std::array<int32_t, MAP_RING_COUNT> offsets{};
+	for (int ring = 0; ring != MAP_RING_COUNT; ++ring) {
+		offsets[ring] = (ring < MAX_TILT) ? -rotation_lookup_table[MAX_TILT - ring].unk0 : rotation_lookup_table[ring - MAX_TILT].unk0;
+	}
+	return offsets;
+}
+
+constexpr std::array<int32_t, MAP_RING_COUNT> MAP_RING_OFFSETS = make_map_ring_offsets(BASE_GLOBE_ROTATION_LOOKUP_TABLE);
+
+// the last ring starting at or before every 8th MAP.BIN byte. The rings are >= 6 bytes long,
+// at most two more start in the next 7 bytes
+constexpr std::array<uint8_t, MAP_BIN_SIZE / 8 + 1> make_map_block_rings()
+{
+	std::array<uint8_t, MAP_BIN_SIZE / 8 + 1> rings{};
+	int ring = 0;
+	for (size_t block = 0; block != rings.size(); ++block) {
+		const int ofs = int(block * 8) - MAP_CENTER_OFS;
+		while (ring + 1 < MAP_RING_COUNT && MAP_RING_OFFSETS[ring + 1] <= ofs) {
+			++ring;
+		}
+		rings[block] = uint8_t(ring);
+	}
+	return rings;
+}
+
+constexpr std::array<uint8_t, MAP_BIN_SIZE / 8 + 1> MAP_BLOCK_RINGS = make_map_block_rings();
+
+// the last ring starting at or before MAP.BIN byte map_index
+int map_ring_at(size_t map_index)
+{
+	const int ofs = int(map_index) - MAP_CENTER_OFS;
+	int ring = MAP_BLOCK_RINGS[map_index / 8];
+	while (ring + 1 < MAP_RING_COUNT && MAP_RING_OFFSETS[ring + 1] <= ofs) {
+		++ring;
+	}
+	return ring;
+}
+
+// in pick_offsets, for the pixels of the bounding rect no row draws
+constexpr uint16_t PICK_OFF_GLOBE = 0xffff;
+static_assert(MAP_BIN_SIZE < PICK_OFF_GLOBE, "map offsets are 16 bit");
+
+}
+
+// + 4: the AVX2 gathers read 32 bits
+kernel_map_planes_t::kernel_map_planes_t(const uint8_t* map)
+	: colored(MAP_BIN_SIZE + 4)
+	, nibbles((MAP_BIN_SIZE + 1) / 2 + 4)
+	, overlay((MAP_BIN_SIZE + 7) / 8 + 4)
+{
+	// TILED: a band of tiles per MAP_TILE_RINGS rings, as wide as its longest ring
+	int band_start = 0;
+	for (int first_ring = 0; first_ring < MAP_RING_COUNT; first_ring += MAP_TILE_RINGS) {
+		const int end_ring = std::min(first_ring + MAP_TILE_RINGS, MAP_RING_COUNT);
+		int columns = 0;
+		for (int ring = first_ring; ring != end_ring; ++ring) {
+			ring_tiles[ring] = band_start + (ring - first_ring) * MAP_TILE_COLUMNS;
+			columns = std::max(columns, map_ring_entry(ring).unk1 * 2);
+		}
+		band_start += (columns + MAP_TILE_COLUMNS - 1) / MAP_TILE_COLUMNS * MAP_TILE_SIZE;
+	}
+	tiled.resize(band_start + 4);
+
+	for (size_t i = 0; i != MAP_BIN_SIZE; ++i) {
+		set(i, map[i]);
+	}
+}
+
+void kernel_map_planes_t::set(size_t map_index, uint8_t value)
+{
+	const uint8_t color = kernel_pixel_color(value);
+	colored[map_index] = color;
+
+	// kernel_pixel_color split into 0x10 + nibble + 12 * overlay bit
+	const uint8_t nibble = value & 0x0f;
+	const bool is_overlay = ((value & 0x30) == 0x10) && (nibble < 8);
+	const int nibble_shift = (map_index & 1) * 4;
+	nibbles[map_index >> 1] = uint8_t((nibbles[map_index >> 1] & ~(0x0f << nibble_shift)) | (nibble << nibble_shift));
+	const int overlay_bit = 1 << (map_index & 7);
+	overlay[map_index >> 3] = uint8_t(is_overlay ? (overlay[map_index >> 3] | overlay_bit) : (overlay[map_index >> 3] & ~overlay_bit));
+
+	// the gaps between the rings are not in TILED
+	const int ring = map_ring_at(map_index);
+	const int column = int(map_index) - MAP_CENTER_OFS - MAP_RING_OFFSETS[ring];
+	if (column >= 0 && column < map_ring_entry(ring).unk1 * 2) {
+		tiled[kernel_tiled_map_index(ring_tiles.data(), ring, column)] = color;
+	}
+}
+
+kernel_map_t kernel_map_planes_t::map(const uint8_t* raw_map) const
+{
+	return { &raw_map[MAP_CENTER_OFS], &colored[MAP_CENTER_OFS], nibbles.data(), overlay.data(), tiled.data(), ring_tiles.data() };
+}
+
+template<globe_map_format_t FORMAT>
+row_kernel_t globe_row_kernel(globe_kernel_t kernel)
+{
+	switch (kernel) {
+	case globe_kernel_t::CHECKED:
+		return nullptr;
+	case globe_kernel_t::SCALAR:
+		return draw_row_scalar<FORMAT>;
+	default:
+		return simd_row_kernel(kernel, FORMAT);
+	}
+}
+
+// nullptr: func2, with the checks (and always the raw map)
+row_kernel_t globe_row_kernel(globe_kernel_t kernel, globe_map_format_t map_format)
+{
+	switch (map_format) {
+	case globe_map_format_t::COLORED:
+		return globe_row_kernel<globe_map_format_t::COLORED>(kernel);
+	case globe_map_format_t::PACKED:
+		return globe_row_kernel<globe_map_format_t::PACKED>(kernel);
+	case globe_map_format_t::TILED:
+		return globe_row_kernel<globe_map_format_t::TILED>(kernel);
+	default:
+		return globe_row_kernel<globe_map_format_t::RAW>(kernel);
+	}
+}
+
+void draw_rows(
+	const draw_tables_t& dt,
+	const globe_program_t& program,
+	int first_row,
+	int end_row,
+	uint8_t* framebuffer,
+	int pitch
+	)
+{
+	for (int r = first_row; r < end_row; ++r)
+	{
+		const auto& row = program.rows[r];
+		const int8_t* gd_vals = &program.gd_vals[row.first_pixel];
+
+		const int framebuffer_line_start = frame_buffer_offset(row.x, row.y, pitch);
+		uint8_t* right_side_globe_pixel = &framebuffer[framebuffer_line_start];
+		uint8_t* left_side_globe_pixel = &framebuffer[framebuffer_line_start - 1];
+
+		if (dt.row_kernel) {
+			dt.row_kernel(dt.kt, gd_vals, row.count, left_side_globe_pixel, right_side_globe_pixel);
+			continue;
+		}
+
+		for (int index = 0; index < row.count; ++index)
+		{
+			func2(
+				dt,
+				dt.all_slices[index],
+				gd_vals[index],
+				left_side_globe_pixel--, right_side_globe_pixel++);
+		}
+	}
+}
+
+// the MAP.BIN offset of every pixel draw_rows draws, into map_offsets holding rect
+void draw_map_offset_rows(
+	const kernel_tables_t& kt,
+	const globe_program_t& program,
+	int first_row,
+	int end_row,
+	uint16_t* map_offsets,
+	const framebuffer_rect_t& rect
+	)
+{
+	for (int r = first_row; r < end_row; ++r) {
+		const auto& row = program.rows[r];
+		const int8_t* gd_vals = &program.gd_vals[row.first_pixel];
+
+		uint16_t* right = &map_offsets[(row.y - rect.y) * rect.w + row.x - rect.x];
+		uint16_t* left = right - 1;
+
+		for (int index = 0; index < row.count; ++index) {
+			const kernel_pixel_pair_t pair = kernel_pixel_pair(kt, index, gd_vals[index]);
+			left[-index] = uint16_t(MAP_CENTER_OFS + pair.grlt_0 + pair.left_column);
+			right[index] = uint16_t(MAP_CENTER_OFS + pair.grlt_0 + pair.right_column);
+		}
+	}
+}
+
+void init_globe_rotation_lookup_table(globe_rotation_lookup_table_t& rotation_lookup_table) {
+	rotation_lookup_table = BASE_GLOBE_ROTATION_LOOKUP_TABLE;
+}
+
+// to show that the table data is not changing over the time
+#define ALWAYS_INIT() (true)
+
+globe_renderer_t::globe_renderer_t()
+{
+	init_globe_rotation_lookup_table(rotation_lookup_table);
+
+#ifdef GLOBE_CHECKED_KERNEL
+	// debug builds: every pixel through the checks, the geometry cache would skip them
+	set_kernel(globe_kernel_t::CHECKED);
+	set_geometry_cache_size(0);
+#else
+	set_kernel(best_globe_kernel());
+	set_geometry_cache_size(4);
+#endif
+}
+
+globe_renderer_t::~globe_renderer_t() = default;
+
+void globe_renderer_t::set_thread_count(unsigned thread_count)
+{
+	if (thread_count <= 1) {
+		pool.reset();
+		bands.clear();
+		return;
+	}
+
+	pool.reset(new worker_pool_t(thread_count));
+
+	// The row lengths differ a lot (14 pixel pairs at the poles, 64 at the equator),
+	// so the bands are cut by pixel count and not by row count. A few more bands
+	// than threads let the pool even out the rest.
+	const size_t total_pixels = GLOBE_PROGRAM.gd_vals.size();
+	const size_t band_count = thread_count * 4;
+	const size_t pixels_per_band = (total_pixels + band_count - 1) / band_count;
+
+	bands.clear();
+	band_t band{ 0, 0 };
+	size_t band_pixels = 0;
+	for (int r = 0; r < GLOBE_PROGRAM.rows.size(); ++r) {
+		band_pixels += GLOBE_PROGRAM.rows[r].count;
+		band.end_row = r + 1;
+		if (band_pixels >= pixels_per_band) {
+			bands.push_back(band);
+			band = band_t{ r + 1, r + 1 };
+			band_pixels = 0;
+		}
+	}
+	if (band.end_row != band.first_row) {
+		bands.push_back(band);
+	}
+}
+
+unsigned globe_renderer_t::thread_count() const
+{
+	return pool ? pool->thread_count() : 1;
+}
+
+void globe_renderer_t::set_geometry_cache_size(unsigned tilt_count)
+{
+	if (tilt_count == 0) {
+		tilt_geometry_cache.reset();
+	} else if (tilt_geometry_cache) {
+		tilt_geometry_cache->set_capacity(tilt_count);
+	} else {
+		tilt_geometry_cache.reset(new globe_geometry_cache_t(tilt_count));
+	}
+}
+
+void globe_renderer_t::set_frame_cache_budget(size_t byte_budget)
+{
+	if (byte_budget == 0) {
+		rendered_frame_cache.reset();
+	} else {
+		rendered_frame_cache.reset(new globe_frame_cache_t(byte_budget));
+	}
+}
+
+void globe_renderer_t::set_kernel(globe_kernel_t kernel)
+{
+	if (!globe_row_kernel(kernel, globe_map_format_t::RAW) && kernel != globe_kernel_t::CHECKED) {
+		kernel = globe_kernel_t::SCALAR;
+	}
+	selected_kernel = kernel;
+	kernel_tilt_class = -1;
+}
+
+void globe_renderer_t::set_picking(bool enabled)
+{
+	if (!enabled) {
+		pick_offsets = std::vector<uint16_t>();
+	} else if (pick_offsets.empty()) {
+		pick_offsets.assign(size_t(GLOBE_BOUNDING_RECT.w) * GLOBE_BOUNDING_RECT.h, PICK_OFF_GLOBE);
+		// the next frame fills them, even for the pose already in dst
+		last_dst = nullptr;
+	}
+	pick_offsets_drawn = false;
+}
+
+globe_pick_t globe_renderer_t::pick(int x, int y) const
+{
+	const framebuffer_rect_t& rect = GLOBE_BOUNDING_RECT;
+	x -= rect.x;
+	y -= rect.y;
+	if (!pick_offsets_drawn || unsigned(x) >= unsigned(rect.w) || unsigned(y) >= unsigned(rect.h)) {
+		return {};
+	}
+
+	const uint16_t map_index = pick_offsets[size_t(y) * rect.w + x];
+	if (map_index == PICK_OFF_GLOBE) {
+		return {};
+	}
+	const int ring = map_ring_at(map_index);
+	return { true, map_index, uint8_t(ring), uint16_t(map_index - MAP_CENTER_OFS - MAP_RING_OFFSETS[ring]) };
+}
+
+void globe_renderer_t::sync_assets(const globe_assets_t& assets)
+{
+	if (assets.generation != asset_generation) {
+		// a different map, nothing drawn so far is right anymore
+		asset_generation = assets.generation;
+		last_dst = nullptr;
+		drop_cached_frames();
+		map_planes.reset();
+		edited_map.clear();
+		edited_cells.clear();
+	}
+}
+
+void globe_renderer_t::drop_cached_frames()
+{
+	if (rendered_frame_cache) {
+		rendered_frame_cache->clear();
+	}
+}
+
+void globe_renderer_t::set_map_cells(size_t map_index, const uint8_t* values, size_t count)
+{
+	assert_throw(map_index <= MAP_BIN_SIZE && count <= MAP_BIN_SIZE - map_index);
+
+	const globe_assets_t& assets = globe_assets();
+	sync_assets(assets);
+	if (edited_map.empty()) {
+		// + 4 zero bytes, like the planes: nothing reads past MAP.BIN
+		edited_map.assign(MAP_BIN_SIZE + 4, 0);
+		std::copy(assets.map, assets.map + MAP_BIN_SIZE, edited_map.begin());
+	}
+
+	bool changed = false;
+	for (size_t i = 0; i != count; ++i) {
+		if (edited_map[map_index + i] == values[i]) {
+			continue;
+		}
+		edited_map[map_index + i] = values[i];
+		if (map_planes) {
+			map_planes->set(map_index + i, values[i]);
+		}
+		edited_cells.push_back(uint32_t(map_index + i));
+		changed = true;
+	}
+
+	if (changed) {
+		drop_cached_frames();
+	}
+}
+
+framebuffer_rect_t globe_renderer_t::redraw_map_edits()
+{
+	framebuffer_rect_t changed{ 0, 0, 0, 0 };
+	if (!last_dst || edited_cells.empty()) {
+		// the next frame is drawn from the edited map anyway
+		edited_cells.clear();
+		return changed;
+	}
+
+	// building the index costs a few frames, like the geometry only once the pose stays:
+	// the first edits of a pose draw the frame again
+	if (map_pixel_index_pitch != last_dst_pitch || map_pixel_index_pose != last_pose) {
+		map_pixel_index_pose = last_pose;
+		map_pixel_index_pitch = last_dst_pitch;
+		map_pixel_index_built = false;
+
+		uint8_t* const dst = last_dst;
+		last_dst = nullptr;
+		render(globe_pose_tilt(map_pixel_index_pose), globe_pose_rotation(map_pixel_index_pose), dst, map_pixel_index_pitch);
+		return globe_bounding_rect();
+	}
+
+	if (!map_pixel_index_built) {
+		if (!map_pixel_index) {
+			map_pixel_index.reset(new globe_map_pixel_index_t());
+		}
+
+		globe_geometry_t built;
+		const globe_geometry_t* geometry = tilt_geometry_cache ? tilt_geometry_cache->find(last_pose.tilt_class) : nullptr;
+		if (!geometry) {
+			build_globe_geometry(built, globe_pose_tilt(last_pose));
+			geometry = &built;
+		}
+
+		// the rotation table may be for another pose, if the last frame came from the frame cache
+		globe_rotation_lookup_table_t pose_rotation_table;
+		init_globe_rotation_lookup_table(pose_rotation_table);
+		precalculate_globe_rotation_lookup_table(pose_rotation_table, globe_pose_rotation(last_pose));
+		globe_entry_fp_hi_t pose_fp_hi{};
+		for (int i = 0; i != pose_rotation_table.size(); ++i) {
+			pose_fp_hi[i] = int16_t(pose_rotation_table[i].fp_hi);
+		}
+
+		map_pixel_index->build(*geometry, pose_fp_hi, last_dst_pitch);
+		map_pixel_index_built = true;
+	}
+
+	uint8_t* const dst = last_dst;
+	int x0 = FRAMEBUFFER_WIDTH, y0 = FRAMEBUFFER_HEIGHT, x1 = 0, y1 = 0;
+	for (uint32_t map_index : edited_cells) {
+		const uint8_t color = kernel_pixel_color(edited_map[map_index]);
+		for (const uint32_t* pixel = map_pixel_index->pixels_begin(map_index); pixel != map_pixel_index->pixels_end(map_index); ++pixel) {
+			dst[*pixel] = color;
+
+			const int x = int(*pixel % uint32_t(last_dst_pitch));
+			const int y = int(*pixel / uint32_t(last_dst_pitch));
+			x0 = std::min(x0, x);
+			y0 = std::min(y0, y);
+			x1 = std::max(x1, x + 1);
+			y1 = std::max(y1, y + 1);
+		}
+	}
+	edited_cells.clear();
+
+	if (x1 > x0) {
+		changed = { x0, y0, x1 - x0, y1 - y0 };
+	}
+	return changed;
+}
+
+bool globe_renderer_t::render(int16_t tilt, uint16_t rotation, uint8_t* dst, int dst_pitch)
+{
+	assert_throw(dst_pitch >= FRAMEBUFFER_WIDTH);
+
+	const globe_assets_t& assets = globe_assets();
+	sync_assets(assets);
+
+	const globe_pose_t pose = canonical_globe_pose(tilt, rotation);
+	if (dst == last_dst && dst_pitch == last_dst_pitch && pose == last_pose) {
+		if (edited_cells.empty()) {
+			return false;
+		}
+		redraw_map_edits();
+		return true;
+	}
+
+	// from here on the frame is drawn from the edited map
+	edited_cells.clear();
+
+	// picking still needs the map offsets of a cached frame
+	const bool frame_loaded = rendered_frame_cache && rendered_frame_cache->load(pose, dst, dst_pitch);
+	if (frame_loaded && !picking()) {
+		last_dst = dst;
+		last_dst_pitch = dst_pitch;
+		last_pose = pose;
+		return true;
+	}
+
+	if (pose.rotation_class != rotation_table_class) {
+#if ALWAYS_INIT()
+		init_globe_rotation_lookup_table(rotation_lookup_table);
+#endif
+		precalculate_globe_rotation_lookup_table(rotation_lookup_table, rotation);
+		rotation_table_class = pose.rotation_class;
+
+		for (int i = 0; i != rotation_lookup_table.size(); ++i) {
+			entry_fp_hi[i] = int16_t(rotation_lookup_table[i].fp_hi);
+		}
+	}
+
+#if 0
+	for (int i = 0; i < rotation_lookup_table.size(); ++i)
+	{
+		printf("[%02i] %u\n", i, rotation_lookup_table[i]);
+	}
+#endif
+
+	const globe_geometry_t* geometry = nullptr;
+	if (tilt_geometry_cache) {
+		geometry = tilt_geometry_cache->find(pose.tilt_class);
+		// only build the geometry once the tilt stays, while the tilt moves it would not pay off
+		if (!geometry && pose.tilt_class == previous_tilt_class) {
+			geometry = &tilt_geometry_cache->insert(pose.tilt_class);
+		}
+	}
+	previous_tilt_class = pose.tilt_class;
+
+	const globe_tilt_lookup_table_t& tilt_lookup_table = globe_tilt_lookup_table(tilt);
+
+	const GLOBDATA_BIN_t* globdata2 = reinterpret_cast<const GLOBDATA_BIN_t*>(assets.globdata);
+
+	const row_kernel_t row_kernel = globe_row_kernel(selected_kernel, selected_map_format);
+	if (!geometry && (row_kernel || picking()) && pose.tilt_class != kernel_tilt_class) {
+		for (int i = 0; i != tilt_lookup_table.size(); ++i) {
+			kernel_tilt_table[i] = decode_tilt_entry(tilt_lookup_table[i]);
+		}
+		kernel_tilt_class = pose.tilt_class;
+	}
+	const uint8_t* const raw_map = edited_map.empty() ? assets.map : edited_map.data();
+	if (selected_map_format != globe_map_format_t::RAW && !map_planes) {
+		map_planes.reset(new kernel_map_planes_t(raw_map));
+	}
+	const kernel_map_t map = map_planes ? map_planes->map(raw_map) : kernel_map_t{ &raw_map[MAP_CENTER_OFS] };
+	const kernel_tables_t kt{ kernel_tilt_table.data(), GLOBE_PROGRAM.slice_values.data(), rotation_lookup_table.data(), map };
+
+	const draw_tables_t dt{ rotation_lookup_table, tilt_lookup_table, globdata2->all_slices, row_kernel, kt };
+
+	uint16_t* const map_offsets = pick_offsets.empty() ? nullptr : pick_offsets.data();
+	const auto draw = [&](int first_row, int end_row) {
+		if (geometry) {
+			if (!frame_loaded) {
+				draw_globe_geometry_rows(*geometry, entry_fp_hi, kt.map, selected_map_format, first_row, end_row, dst, dst_pitch);
+			}
+			if (map_offsets) {
+				draw_globe_geometry_map_offset_rows(*geometry, entry_fp_hi, first_row, end_row, map_offsets, GLOBE_BOUNDING_RECT);
+			}
+		} else {
+			if (!frame_loaded) {
+				draw_rows(dt, GLOBE_PROGRAM, first_row, end_row, dst, dst_pitch);
+			}
+			if (map_offsets) {
+				draw_map_offset_rows(kt, GLOBE_PROGRAM, first_row, end_row, map_offsets, GLOBE_BOUNDING_RECT);
+			}
+		}
+	};
+
+	if (!pool) {
+		draw(0, int(GLOBE_PROGRAM.rows.size()));
+	} else {
+		// every row only reads the tables and writes its own framebuffer span
+		pool->run(int(bands.size()), [&](int i) {
+			draw(bands[i].first_row, bands[i].end_row);
+		});
+	}
+
+	if (rendered_frame_cache && !frame_loaded) {
+		rendered_frame_cache->store(pose, dst, dst_pitch);
+	}
+	pick_offsets_drawn = map_offsets != nullptr;
+
+	last_dst = dst;
+	last_dst_pitch = dst_pitch;
+	last_pose = pose;
+	return true;
+}
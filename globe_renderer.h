@@ -0,0 +1,316 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "globe_assets.h"
+
+class worker_pool_t;
+class globe_geometry_cache_t;
+class globe_frame_cache_t;
+class globe_map_pixel_index_t;
+struct kernel_map_planes_t;
+
+// globe dimensions: 128 x 109 pixel
+//   128 = (left: 96, right : 96)
+//	 109 =
+//     top: 55 (northern hemisphere, full globe_lines starting from 0)
+//     bottom: 54 (southern hemisphere, globe_lines starting from 1)
+
+constexpr int FRAMEBUFFER_WIDTH = 320;
+constexpr int FRAMEBUFFER_HEIGHT = 200;
+
+#define assert_throw(CONDITION) \
+  if( !(CONDITION) ) \
+  { \
+    printf("line: %i\n", __LINE__); \
+    assert(false); \
+	throw 0xdeadbeef; \
+  }
+
+
+struct rotation_lookup_table_entry_t {
+	uint16_t unk0;
+	uint16_t unk1;
+	uint16_t fp_hi;
+	uint16_t fp_lo;
+};
+static_assert(sizeof(rotation_lookup_table_entry_t) == 8, "wrong size");
+
+constexpr int MAX_TILT = 98;
+using globe_rotation_lookup_table_t = std::array<rotation_lookup_table_entry_t, MAX_TILT+1>;
+using globe_tilt_lookup_table_t = std::array<uint16_t, MAX_TILT*2>;
+
+// layout of GLOBDATA_BIN
+#pragma pack(push,1)
+struct table_values_t
+{
+	std::array<uint8_t, 99> value;
+	uint8_t unused; // forming the grey horizontal lines on the image with the two tables
+};
+
+struct table_slices_t
+{
+	// in the parallel tables
+	table_values_t table0_slice; // left slice
+	table_values_t table1_slice; // right slice
+};
+
+struct GLOBDATA_BIN_t
+{
+	std::array<uint8_t, 3290> unk0;
+	std::array<table_slices_t, 64> all_slices;
+	uint8_t unused;
+};
+#pragma pack(pop)
+static_assert(offsetof(GLOBDATA_BIN_t, unk0) == 0, "wrong offset");
+static_assert(sizeof(GLOBDATA_BIN_t::unk0) == 3290, "wrong size");
+static_assert(offsetof(GLOBDATA_BIN_t, all_slices) == 3290,"wrong offset");
+static_assert(sizeof(GLOBDATA_BIN_t::all_slices) == 12800, "wrong size");
+static_assert(sizeof(GLOBDATA_BIN_t) == GLOBDATA_BIN_SIZE, "wrong size");
+
+constexpr int SLICE_VALUE_COUNT = 100;
+
+// checked against GLOBDATA_BIN while it is decoded (at compile time)
+constexpr int GLOBE_LINE_COUNT = 55;
+constexpr int GLOBE_ROW_COUNT = GLOBE_LINE_COUNT * 2 - 1; // line 0 is only in the northern hemisphere
+constexpr int GLOBE_PIXEL_PAIR_COUNT = 5558;
+
+/*
+ *  The globe lines compiled into one flat program, rows in framebuffer order
+ *  (northern hemisphere lines reversed, then the southern ones).
+ *  Pixel pair i of a row is drawn with slice i to (x-1-i, y) and (x+i, y).
+ */
+struct globe_program_t
+{
+	struct row_t
+	{
+		int16_t x;
+		int16_t y;
+		uint16_t first_pixel; // into gd_vals
+		uint16_t count;
+	};
+
+	std::array<row_t, GLOBE_ROW_COUNT> rows;
+
+	// index into the tilt lookup table (- MAX_TILT), already negated for the southern hemisphere
+	std::array<int8_t, GLOBE_PIXEL_PAIR_COUNT> gd_vals;
+
+	// all_slices merged: table0 / 2 (the rotation table entry) | table1 << 8,
+	// at [slice * SLICE_VALUE_COUNT + offset1]. +1 padding for 32 bit gathers
+	std::array<uint16_t, 64 * SLICE_VALUE_COUNT + 1> slice_values;
+};
+
+/*
+ *  Canonical pose: precalculate_globe_rotation_lookup_table only uses
+ *  floor(rotation * 398 / 0x10000) and the tilt is clamped to [-MAX_TILT, MAX_TILT],
+ *  so 197 x 398 poses cover every frame the renderer can produce.
+ */
+constexpr int GLOBE_TILT_CLASS_COUNT = MAX_TILT*2+1;
+constexpr int GLOBE_ROTATION_CLASS_COUNT = 398;
+constexpr int GLOBE_POSE_COUNT = GLOBE_TILT_CLASS_COUNT * GLOBE_ROTATION_CLASS_COUNT;
+
+struct globe_pose_t
+{
+	int16_t tilt_class{};     // clamped tilt + MAX_TILT
+	int16_t rotation_class{}; // rotation * 398 >> 16
+};
+
+constexpr bool operator==(globe_pose_t a, globe_pose_t b) { return a.tilt_class == b.tilt_class && a.rotation_class == b.rotation_class; }
+constexpr bool operator!=(globe_pose_t a, globe_pose_t b) { return !(a == b); }
+
+constexpr
+globe_pose_t canonical_globe_pose(int16_t tilt, uint16_t rotation)
+{
+	const int clamped_tilt = (tilt < -MAX_TILT) ? -MAX_TILT : (tilt > MAX_TILT) ? MAX_TILT : tilt;
+	return { int16_t(clamped_tilt + MAX_TILT), int16_t((uint32_t(rotation) * GLOBE_ROTATION_CLASS_COUNT) >> 16) };
+}
+
+// a tilt/rotation rendering the pose (the smallest rotation of its class)
+constexpr int16_t globe_pose_tilt(globe_pose_t pose) { return int16_t(pose.tilt_class - MAX_TILT); }
+constexpr uint16_t globe_pose_rotation(globe_pose_t pose) { return uint16_t((uint32_t(pose.rotation_class) * 0x10000 + GLOBE_ROTATION_CLASS_COUNT - 1) / GLOBE_ROTATION_CLASS_COUNT); }
+
+// 0 .. GLOBE_POSE_COUNT-1, tilt major
+constexpr int globe_pose_index(globe_pose_t pose) { return pose.tilt_class * GLOBE_ROTATION_CLASS_COUNT + pose.rotation_class; }
+constexpr globe_pose_t globe_pose_from_index(int index) { return { int16_t(index / GLOBE_ROTATION_CLASS_COUNT), int16_t(index % GLOBE_ROTATION_CLASS_COUNT) }; }
+
+// implementation of the per pixel path (func2 -> func1 -> set_pixel_color)
+enum class globe_kernel_t
+{
+	CHECKED, // the reference code with its per pixel checks, for debugging
+	SCALAR,  // the same without the checks, validate_globe_tables() proves them at compile time
+	SSE41,
+	AVX2
+};
+
+// fastest kernel supported by this cpu
+globe_kernel_t best_globe_kernel();
+
+// how the unchecked kernels and the geometry path read MAP.BIN (CHECKED always reads the bytes)
+enum class globe_map_format_t
+{
+	RAW,     // the map bytes, turned into a palette index per pixel
+	COLORED, // a copy already turned into palette indices (~50 KB)
+	PACKED,  // palette index - 0x10 in 4 bits plus a bit per pixel for the +12 overlay (~31 KB)
+	TILED    // COLORED reordered into 64 byte tiles of 8 neighbouring latitude rings x 8 columns (~53 KB)
+};
+
+struct framebuffer_rect_t
+{
+	int x;
+	int y;
+	int w;
+	int h;
+};
+
+constexpr framebuffer_rect_t FRAMEBUFFER_RECT{ 0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT };
+
+// the MAP.BIN byte under a framebuffer pixel, see globe_renderer_t::pick
+struct globe_pick_t
+{
+	bool on_globe;      // false: the rest is 0
+	uint16_t map_index; // MAP.BIN offset
+	uint8_t ring;       // latitude ring (map row), 0 .. 2 * MAX_TILT from the top
+	uint16_t column;    // byte in the ring
+};
+
+// decoded from GLOBDATA_BIN/TABLAT_BIN at compile time
+const globe_program_t& globe_program();
+// bounding rectangle of the globe rows, render() does not write outside of it
+const framebuffer_rect_t& globe_bounding_rect();
+const globe_rotation_lookup_table_t& base_globe_rotation_lookup_table();
+// all 197 tilts are precalculated, globe_tilt is clamped to [-MAX_TILT, MAX_TILT]
+const globe_tilt_lookup_table_t& globe_tilt_lookup_table(int16_t globe_tilt);
+
+void init_globe_rotation_lookup_table(globe_rotation_lookup_table_t& rotation_lookup_table);
+void precalculate_globe_rotation_lookup_table(globe_rotation_lookup_table_t& rotation_lookup_table, uint16_t globe_rotation);
+
+/*
+ *  Render context for one globe: owns its rotation lookup table (the rest is
+ *  constant), renders into a caller supplied 8-bit (palette index) buffer.
+ *  Does not touch any global state, so every thread can use its own renderer.
+ */
+class globe_renderer_t
+{
+public:
+	globe_renderer_t();
+	~globe_renderer_t();
+
+	// > 1 renders the rows in parallel on a pool of persistent threads
+	void set_thread_count(unsigned thread_count);
+	unsigned thread_count() const;
+
+	// keeps the per pixel geometry of the last tilt_count tilts (~44 KB each), so frames
+	// that only change the rotation skip most of the per pixel work. 0 turns it off
+	void set_geometry_cache_size(unsigned tilt_count);
+	// nullptr if turned off, for the memory use and hit counters
+	const globe_geometry_cache_t* geometry_cache() const { return tilt_geometry_cache.get(); }
+
+	// keeps rendered frames (~11 KB each) up to byte_budget, a cached pose is just copied
+	// into dst. 0 (the default) turns it off
+	void set_frame_cache_budget(size_t byte_budget);
+	// nullptr if turned off, for the memory use and hit/miss/eviction counters
+	const globe_frame_cache_t* frame_cache() const { return rendered_frame_cache.get(); }
+
+	// defaults to best_globe_kernel(), all kernels render the same pixels
+	void set_kernel(globe_kernel_t kernel);
+	globe_kernel_t kernel() const { return selected_kernel; }
+
+	// defaults to COLORED, the other formats are built from the map on first use
+	void set_map_format(globe_map_format_t format) { selected_map_format = format; }
+	globe_map_format_t map_format() const { return selected_map_format; }
+
+	// dst has to hold FRAMEBUFFER_HEIGHT lines of dst_pitch (>= FRAMEBUFFER_WIDTH) bytes,
+	// only the globe pixels are written.
+	// Returns false (and draws nothing) if dst already holds the canonical pose of tilt/rotation.
+	bool render(int16_t tilt, uint16_t rotation, uint8_t* dst, int dst_pitch = FRAMEBUFFER_WIDTH);
+	// globe_assets().generation the last render() drew with
+	unsigned assets_generation() const { return asset_generation; }
+
+	// forget the last frame, e.g. after dst was cleared by the caller
+	void invalidate() { last_dst = nullptr; }
+
+	/*
+	 *  Writes count bytes from MAP.BIN index map_index into this renderer's copy of the
+	 *  map, e.g. ownership or overlay bits. Every later frame shows them, and the frame
+	 *  cache is dropped. A change of globe_assets() drops the edits.
+	 */
+	void set_map_cells(size_t map_index, const uint8_t* values, size_t count);
+	void set_map_cell(size_t map_index, uint8_t value) { set_map_cells(map_index, &value, 1); }
+
+	/*
+	 *  Re-colors only the pixels of the last frame that show a map byte edited since it was
+	 *  drawn. They are looked up in a map byte -> pixels index of the pose, built on the
+	 *  second call for the same pose (the first one draws the whole frame again, the index
+	 *  costs a few frames). render() of the same pose into the same dst calls it.
+	 *  Returns the bounding rectangle of the re-colored pixels, for presenting only that
+	 *  (w == 0: nothing changed).
+	 */
+	framebuffer_rect_t redraw_map_edits();
+
+	/*
+	 *  true: every frame also stores the MAP.BIN offset of each globe pixel it draws
+	 *  (~28 KB, allocated here), for pick(). Frames take 30-60% longer, off by default.
+	 */
+	void set_picking(bool enabled);
+	bool picking() const { return !pick_offsets.empty(); }
+
+	// the map byte under framebuffer pixel (x, y) of the last frame, a table lookup.
+	// Off the globe for every pixel until a frame is drawn with picking
+	globe_pick_t pick(int x, int y) const;
+
+	const globe_program_t& program() const { return globe_program(); }
+
+private:
+	// drops everything drawn from an older map
+	void sync_assets(const globe_assets_t& assets);
+	void drop_cached_frames();
+
+	// consecutive program rows, drawn by one worker
+	struct band_t
+	{
+		int first_row;
+		int end_row;
+	};
+
+	globe_rotation_lookup_table_t rotation_lookup_table{};
+	int rotation_table_class = -1; // rotation class rotation_lookup_table is precalculated for
+	std::array<int16_t, MAX_TILT+1> entry_fp_hi{}; // rotation_lookup_table[i].fp_hi
+
+	std::unique_ptr<globe_geometry_cache_t> tilt_geometry_cache;
+	std::unique_ptr<globe_frame_cache_t> rendered_frame_cache;
+	int previous_tilt_class = -1;
+
+	globe_kernel_t selected_kernel = globe_kernel_t::SCALAR;
+	std::array<int32_t, MAX_TILT*2> kernel_tilt_table{};
+	int kernel_tilt_class = -1;
+
+	unsigned asset_generation = 0; // globe_assets().generation the cached frames were drawn with
+
+	globe_map_format_t selected_map_format = globe_map_format_t::COLORED;
+	std::unique_ptr<kernel_map_planes_t> map_planes; // of the map of asset_generation, with the edits
+
+	std::vector<uint8_t> edited_map;   // empty: no edits, the kernels read globe_assets().map
+	std::vector<uint32_t> edited_cells; // MAP.BIN indices edited since the last frame was drawn
+	std::unique_ptr<globe_map_pixel_index_t> map_pixel_index;
+	globe_pose_t map_pixel_index_pose{}; // the last frame edits came in for
+	int map_pixel_index_pitch = 0;
+	bool map_pixel_index_built = false;  // for that frame
+
+	// globe_bounding_rect() of the last frame with picking, MAP.BIN offsets or PICK_OFF_GLOBE
+	std::vector<uint16_t> pick_offsets;
+	bool pick_offsets_drawn = false;
+
+	// the last frame drawn
+	uint8_t* last_dst = nullptr;
+	int last_dst_pitch = 0;
+	globe_pose_t last_pose{};
+
+	std::unique_ptr<worker_pool_t> pool;
+	std::vector<band_t> bands;
+};
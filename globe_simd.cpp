@@ -0,0 +1,392 @@
+#include "globe_kernel.h"
+
+/*
+ *  SSE4.1 and AVX2 versions of the func2/func1/set_pixel_color path, 8 pixel pairs per step.
+ *  Compiled with function level target attributes, so the rest of the program does
+ *  not need -mavx2, the renderer picks the kernel at runtime (best_globe_kernel).
+ */
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define GLOBE_SIMD_X86 1
+#else
+#define GLOBE_SIMD_X86 0
+#endif
+
+#if GLOBE_SIMD_X86
+
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define GLOBE_TARGET(ISA)
+#else
+#define GLOBE_TARGET(ISA) __attribute__((target(ISA)))
+#endif
+
+namespace {
+
+// writes the 8 left pixels (mirrored) and the 8 right pixels of one step
+GLOBE_TARGET("sse4.1")
+inline
+void store_pixel_pairs(__m128i left_colors, __m128i right_colors, uint8_t* left, uint8_t* right)
+{
+	// [l0..l7 r0..r7], 32 -> 16 bit was done by the caller
+	const __m128i bytes = _mm_packus_epi16(left_colors, right_colors);
+	const __m128i reverse_left = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, -1, -1, -1, -1, -1, -1, -1, -1);
+
+	_mm_storel_epi64(reinterpret_cast<__m128i*>(left - 7), _mm_shuffle_epi8(bytes, reverse_left));
+	_mm_storel_epi64(reinterpret_cast<__m128i*>(right), _mm_srli_si128(bytes, 8));
+}
+
+//----------------------------------------------------------------------------
+// SSE4.1: no gather instruction, the loads are done per lane, the arithmetic
+// and the sign dependent selects are vectorized
+
+GLOBE_TARGET("sse4.1")
+inline
+__m128i gather_u8_sse41(const uint8_t* base, __m128i ofs)
+{
+	return _mm_setr_epi32(
+		base[_mm_cvtsi128_si32(ofs)],
+		base[_mm_extract_epi32(ofs, 1)],
+		base[_mm_extract_epi32(ofs, 2)],
+		base[_mm_extract_epi32(ofs, 3)]);
+}
+
+GLOBE_TARGET("sse4.1")
+inline
+__m128i gather_u16_sse41(const uint16_t* base, __m128i ofs)
+{
+	return _mm_setr_epi32(
+		base[_mm_cvtsi128_si32(ofs)],
+		base[_mm_extract_epi32(ofs, 1)],
+		base[_mm_extract_epi32(ofs, 2)],
+		base[_mm_extract_epi32(ofs, 3)]);
+}
+
+GLOBE_TARGET("sse4.1")
+inline
+__m128i gather_i32_sse41(const int32_t* base, __m128i ofs)
+{
+	return _mm_setr_epi32(
+		base[_mm_cvtsi128_si32(ofs)],
+		base[_mm_extract_epi32(ofs, 1)],
+		base[_mm_extract_epi32(ofs, 2)],
+		base[_mm_extract_epi32(ofs, 3)]);
+}
+
+GLOBE_TARGET("sse4.1")
+inline
+__m128i pixel_color_sse41(__m128i value)
+{
+	const __m128i color = _mm_and_si128(value, _mm_set1_epi32(0x0f));
+	const __m128i is_overlay = _mm_and_si128(
+		_mm_cmpeq_epi32(_mm_and_si128(value, _mm_set1_epi32(0x30)), _mm_set1_epi32(0x10)),
+		_mm_cmplt_epi32(color, _mm_set1_epi32(8)));
+	const __m128i overlay = _mm_and_si128(is_overlay, _mm_set1_epi32(12));
+	return _mm_add_epi32(_mm_add_epi32(color, overlay), _mm_set1_epi32(0x10));
+}
+
+// kernel_tiled_map_index as shifts
+static_assert(MAP_TILE_COLUMNS == 8 && MAP_TILE_SIZE == 64, "the SIMD kernels shift by 3 and 6");
+
+// palette indices of 4 pixels, see kernel_map_color
+template<globe_map_format_t FORMAT>
+GLOBE_TARGET("sse4.1")
+inline
+__m128i map_colors_sse41(const kernel_map_t& map, __m128i ring, __m128i grlt_0, __m128i column)
+{
+	if constexpr (FORMAT == globe_map_format_t::TILED) {
+		const __m128i tile_ofs = _mm_add_epi32(
+			_mm_slli_epi32(_mm_srli_epi32(column, 3), 6),
+			_mm_and_si128(column, _mm_set1_epi32(MAP_TILE_COLUMNS - 1)));
+		return gather_u8_sse41(map.tiled, _mm_add_epi32(gather_i32_sse41(map.ring_tiles, ring), tile_ofs));
+	}
+
+	const __m128i ofs = _mm_add_epi32(grlt_0, column);
+	if constexpr (FORMAT == globe_map_format_t::COLORED) {
+		return gather_u8_sse41(map.colored, ofs);
+	} else if constexpr (FORMAT == globe_map_format_t::PACKED) {
+		// per lane anyway, without a gather
+		return _mm_setr_epi32(
+			kernel_map_color<FORMAT>(map, 0, 0, _mm_cvtsi128_si32(ofs)),
+			kernel_map_color<FORMAT>(map, 0, 0, _mm_extract_epi32(ofs, 1)),
+			kernel_map_color<FORMAT>(map, 0, 0, _mm_extract_epi32(ofs, 2)),
+			kernel_map_color<FORMAT>(map, 0, 0, _mm_extract_epi32(ofs, 3)));
+	} else {
+		return pixel_color_sse41(gather_u8_sse41(map.raw, ofs));
+	}
+}
+
+// 4 pixel pairs, returns the left and right palette indices as 32 bit lanes
+template<globe_map_format_t FORMAT>
+GLOBE_TARGET("sse4.1")
+inline
+void pixel_pairs_sse41(const kernel_tables_t& kt, __m128i gd_val, __m128i slice_ofs, __m128i& left_color, __m128i& right_color)
+{
+	const __m128i tilt = gather_i32_sse41(kt.tilt + MAX_TILT, gd_val);
+	const __m128i offset1 = _mm_and_si128(tilt, _mm_set1_epi32(0xff));
+	const __m128i lo_negative = _mm_cmpeq_epi32(_mm_and_si128(tilt, _mm_set1_epi32(TILT_LO_NEGATIVE)), _mm_set1_epi32(TILT_LO_NEGATIVE));
+	const __m128i negative = _mm_cmpeq_epi32(_mm_and_si128(tilt, _mm_set1_epi32(TILT_NEGATIVE)), _mm_set1_epi32(TILT_NEGATIVE));
+
+	const __m128i slice_value = gather_u16_sse41(kt.slice_values, _mm_add_epi32(slice_ofs, offset1));
+	const __m128i entry_index = _mm_and_si128(slice_value, _mm_set1_epi32(0xff));
+	const __m128i table1 = _mm_srli_epi32(slice_value, 8);
+
+	// two int32 per entry
+	const int32_t* rotation = reinterpret_cast<const int32_t*>(kt.rotation);
+	const __m128i entry_ofs = _mm_add_epi32(entry_index, entry_index);
+	const __m128i unk0_unk1 = gather_i32_sse41(rotation, entry_ofs);
+	const __m128i fp_hi = _mm_and_si128(gather_i32_sse41(rotation + 1, entry_ofs), _mm_set1_epi32(0xffff));
+	const __m128i unk0 = _mm_and_si128(unk0_unk1, _mm_set1_epi32(0xffff));
+	const __m128i unk1 = _mm_srli_epi32(unk0_unk1, 16);
+
+	const __m128i ring = _mm_add_epi32(_mm_set1_epi32(MAX_TILT), _mm_blendv_epi8(entry_index, _mm_sub_epi32(_mm_setzero_si128(), entry_index), negative));
+	const __m128i grlt_0 = _mm_blendv_epi8(unk0, _mm_sub_epi32(_mm_setzero_si128(), unk0), negative);
+	const __m128i gd = _mm_blendv_epi8(table1, _mm_sub_epi32(unk1, table1), lo_negative);
+	const __m128i grlt_1 = _mm_add_epi32(unk1, unk1);
+
+	__m128i left_ofs = _mm_sub_epi32(fp_hi, gd);
+	left_ofs = _mm_add_epi32(left_ofs, _mm_and_si128(_mm_srai_epi32(left_ofs, 31), grlt_1));
+
+	__m128i right_ofs = _mm_sub_epi32(_mm_add_epi32(fp_hi, gd), grlt_1);
+	right_ofs = _mm_add_epi32(right_ofs, _mm_and_si128(_mm_srai_epi32(right_ofs, 31), grlt_1));
+
+	left_color = map_colors_sse41<FORMAT>(kt.map, ring, grlt_0, left_ofs);
+	right_color = map_colors_sse41<FORMAT>(kt.map, ring, grlt_0, right_ofs);
+}
+
+template<globe_map_format_t FORMAT>
+GLOBE_TARGET("sse4.1")
+void draw_row_sse41(const kernel_tables_t& kt, const int8_t* gd_vals, int count, uint8_t* left, uint8_t* right)
+{
+	constexpr int SLICE_SIZE = SLICE_VALUE_COUNT;
+	const __m128i lane_slice_ofs = _mm_setr_epi32(0, SLICE_SIZE, 2 * SLICE_SIZE, 3 * SLICE_SIZE);
+
+	int index = 0;
+	for (; index + 8 <= count; index += 8) {
+		const __m128i gd_val = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(gd_vals + index));
+		const __m128i gd_val_0 = _mm_cvtepi8_epi32(gd_val);
+		const __m128i gd_val_1 = _mm_cvtepi8_epi32(_mm_srli_si128(gd_val, 4));
+
+		const __m128i slice_ofs_0 = _mm_add_epi32(_mm_set1_epi32(index * SLICE_SIZE), lane_slice_ofs);
+		const __m128i slice_ofs_1 = _mm_add_epi32(slice_ofs_0, _mm_set1_epi32(4 * SLICE_SIZE));
+
+		__m128i left_0, right_0, left_1, right_1;
+		pixel_pairs_sse41<FORMAT>(kt, gd_val_0, slice_ofs_0, left_0, right_0);
+		pixel_pairs_sse41<FORMAT>(kt, gd_val_1, slice_ofs_1, left_1, right_1);
+
+		store_pixel_pairs(_mm_packus_epi32(left_0, left_1), _mm_packus_epi32(right_0, right_1), left - index, right + index);
+	}
+
+	for (; index < count; ++index) {
+		kernel_draw_pixel_pair<FORMAT>(kt, index, gd_vals[index], left - index, right + index);
+	}
+}
+
+//----------------------------------------------------------------------------
+// AVX2: 8 lanes with hardware gathers. The 32 bit gathers of 8/16 bit tables
+// read past the wanted value, globe_program_t::slice_values and the
+// COLORED/PACKED/TILED planes are padded for that. The RAW map is not (the last
+// byte a pixel reads is the last one of MAP.BIN), it is read with the 32 bits
+// ending at the wanted byte, validate_globe_tables proves those are inside.
+
+// all lanes, merging into zero instead of whatever register the compiler picks
+template<int SCALE>
+GLOBE_TARGET("avx2")
+inline
+__m256i gather_i32_avx2(const void* base, __m256i ofs)
+{
+	return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(base), ofs, _mm256_set1_epi32(-1), SCALE);
+}
+
+GLOBE_TARGET("avx2")
+inline
+__m256i gather_u8_avx2(const uint8_t* base, __m256i ofs)
+{
+	return _mm256_and_si256(gather_i32_avx2<1>(base, ofs), _mm256_set1_epi32(0xff));
+}
+
+// base[ofs] from the 32 bits ending at it, for the unpadded RAW map
+GLOBE_TARGET("avx2")
+inline
+__m256i gather_u8_ending_avx2(const uint8_t* base, __m256i ofs)
+{
+	return _mm256_srli_epi32(gather_i32_avx2<1>(base - RAW_MAP_GATHER_BACK, ofs), 24);
+}
+
+GLOBE_TARGET("avx2")
+inline
+__m256i pixel_color_avx2(__m256i value)
+{
+	const __m256i color = _mm256_and_si256(value, _mm256_set1_epi32(0x0f));
+	const __m256i is_overlay = _mm256_and_si256(
+		_mm256_cmpeq_epi32(_mm256_and_si256(value, _mm256_set1_epi32(0x30)), _mm256_set1_epi32(0x10)),
+		_mm256_cmpgt_epi32(_mm256_set1_epi32(8), color));
+	const __m256i overlay = _mm256_and_si256(is_overlay, _mm256_set1_epi32(12));
+	return _mm256_add_epi32(_mm256_add_epi32(color, overlay), _mm256_set1_epi32(0x10));
+}
+
+// palette indices of 8 pixels, see kernel_map_color
+template<globe_map_format_t FORMAT>
+GLOBE_TARGET("avx2")
+inline
+__m256i map_colors_avx2(const kernel_map_t& map, __m256i ring, __m256i grlt_0, __m256i column)
+{
+	if constexpr (FORMAT == globe_map_format_t::TILED) {
+		const __m256i tile_ofs = _mm256_add_epi32(
+			_mm256_slli_epi32(_mm256_srli_epi32(column, 3), 6),
+			_mm256_and_si256(column, _mm256_set1_epi32(MAP_TILE_COLUMNS - 1)));
+		return gather_u8_avx2(map.tiled, _mm256_add_epi32(gather_i32_avx2<4>(map.ring_tiles, ring), tile_ofs));
+	}
+
+	const __m256i ofs = _mm256_add_epi32(grlt_0, column);
+	if constexpr (FORMAT == globe_map_format_t::COLORED) {
+		return gather_u8_avx2(map.colored, ofs);
+	} else if constexpr (FORMAT == globe_map_format_t::PACKED) {
+		const __m256i i = _mm256_add_epi32(ofs, _mm256_set1_epi32(MAP_CENTER_OFS));
+		const __m256i nibble_shift = _mm256_slli_epi32(_mm256_and_si256(i, _mm256_set1_epi32(1)), 2);
+		const __m256i color = _mm256_and_si256(
+			_mm256_srlv_epi32(gather_i32_avx2<1>(map.nibbles, _mm256_srli_epi32(i, 1)), nibble_shift),
+			_mm256_set1_epi32(0x0f));
+		const __m256i overlay_bit = _mm256_and_si256(
+			_mm256_srlv_epi32(gather_i32_avx2<1>(map.overlay, _mm256_srli_epi32(i, 3)), _mm256_and_si256(i, _mm256_set1_epi32(7))),
+			_mm256_set1_epi32(1));
+		const __m256i overlay = _mm256_and_si256(_mm256_sub_epi32(_mm256_setzero_si256(), overlay_bit), _mm256_set1_epi32(12));
+		return _mm256_add_epi32(_mm256_add_epi32(color, overlay), _mm256_set1_epi32(0x10));
+	} else {
+		return pixel_color_avx2(gather_u8_ending_avx2(map.raw, ofs));
+	}
+}
+
+template<globe_map_format_t FORMAT>
+GLOBE_TARGET("avx2")
+void draw_row_avx2(const kernel_tables_t& kt, const int8_t* gd_vals, int count, uint8_t* left, uint8_t* right)
+{
+	constexpr int SLICE_SIZE = SLICE_VALUE_COUNT;
+	const __m256i lane_slice_ofs = _mm256_setr_epi32(
+		0, SLICE_SIZE, 2 * SLICE_SIZE, 3 * SLICE_SIZE, 4 * SLICE_SIZE, 5 * SLICE_SIZE, 6 * SLICE_SIZE, 7 * SLICE_SIZE);
+	// the stores may alias everything, keep the table pointers in registers
+	const int32_t* const tilt_table = kt.tilt + MAX_TILT;
+	const uint16_t* const slice_values = kt.slice_values;
+	const int32_t* const rotation = reinterpret_cast<const int32_t*>(kt.rotation);
+	const kernel_map_t map = kt.map;
+
+	int index = 0;
+	for (; index + 8 <= count; index += 8) {
+		const __m256i gd_val = _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(gd_vals + index)));
+
+		const __m256i tilt = gather_i32_avx2<4>(tilt_table, gd_val);
+		const __m256i offset1 = _mm256_and_si256(tilt, _mm256_set1_epi32(0xff));
+		const __m256i lo_negative = _mm256_cmpeq_epi32(_mm256_and_si256(tilt, _mm256_set1_epi32(TILT_LO_NEGATIVE)), _mm256_set1_epi32(TILT_LO_NEGATIVE));
+		const __m256i negative = _mm256_cmpeq_epi32(_mm256_and_si256(tilt, _mm256_set1_epi32(TILT_NEGATIVE)), _mm256_set1_epi32(TILT_NEGATIVE));
+
+		const __m256i ofs = _mm256_add_epi32(_mm256_add_epi32(_mm256_set1_epi32(index * SLICE_SIZE), lane_slice_ofs), offset1);
+		const __m256i slice_value = gather_i32_avx2<2>(slice_values, ofs);
+		const __m256i entry_index = _mm256_and_si256(slice_value, _mm256_set1_epi32(0xff));
+		const __m256i table1 = _mm256_and_si256(_mm256_srli_epi32(slice_value, 8), _mm256_set1_epi32(0xff));
+
+		const __m256i unk0_unk1 = gather_i32_avx2<8>(rotation, entry_index);
+		const __m256i fp_hi = _mm256_and_si256(gather_i32_avx2<8>(rotation + 1, entry_index), _mm256_set1_epi32(0xffff));
+		const __m256i unk0 = _mm256_and_si256(unk0_unk1, _mm256_set1_epi32(0xffff));
+		const __m256i unk1 = _mm256_srli_epi32(unk0_unk1, 16);
+
+		const __m256i ring = _mm256_add_epi32(_mm256_set1_epi32(MAX_TILT), _mm256_blendv_epi8(entry_index, _mm256_sub_epi32(_mm256_setzero_si256(), entry_index), negative));
+		const __m256i grlt_0 = _mm256_blendv_epi8(unk0, _mm256_sub_epi32(_mm256_setzero_si256(), unk0), negative);
+		const __m256i gd = _mm256_blendv_epi8(table1, _mm256_sub_epi32(unk1, table1), lo_negative);
+		const __m256i grlt_1 = _mm256_add_epi32(unk1, unk1);
+
+		__m256i left_ofs = _mm256_sub_epi32(fp_hi, gd);
+		left_ofs = _mm256_add_epi32(left_ofs, _mm256_and_si256(_mm256_srai_epi32(left_ofs, 31), grlt_1));
+
+		__m256i right_ofs = _mm256_sub_epi32(_mm256_add_epi32(fp_hi, gd), grlt_1);
+		right_ofs = _mm256_add_epi32(right_ofs, _mm256_and_si256(_mm256_srai_epi32(right_ofs, 31), grlt_1));
+
+		const __m256i left_color = map_colors_avx2<FORMAT>(map, ring, grlt_0, left_ofs);
+		const __m256i right_color = map_colors_avx2<FORMAT>(map, ring, grlt_0, right_ofs);
+
+		// [l0-3 r0-3 | l4-7 r4-7] -> [l0-7 | r0-7] as 16 bit
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(left_color, right_color), 0xd8);
+		store_pixel_pairs(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1), left - index, right + index);
+	}
+
+	for (; index < count; ++index) {
+		kernel_draw_pixel_pair<FORMAT>(kt, index, gd_vals[index], left - index, right + index);
+	}
+}
+
+} // namespace
+
+globe_kernel_t best_globe_kernel()
+{
+#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 0);
+	const int max_leaf = regs[0];
+	__cpuid(regs, 1);
+	const bool has_sse41 = (regs[2] & (1 << 19)) != 0;
+	const bool has_avx = (regs[2] & (1 << 28)) != 0 && (regs[2] & (1 << 27)) != 0
+		&& (_xgetbv(0) & 0x6) == 0x6;
+	bool has_avx2 = false;
+	if (has_avx && max_leaf >= 7) {
+		__cpuidex(regs, 7, 0);
+		has_avx2 = (regs[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	const bool has_sse41 = __builtin_cpu_supports("sse4.1");
+	const bool has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+	if (has_avx2) {
+		return globe_kernel_t::AVX2;
+	}
+	if (has_sse41) {
+		return globe_kernel_t::SSE41;
+	}
+	return globe_kernel_t::SCALAR;
+}
+
+namespace {
+
+template<globe_map_format_t FORMAT>
+row_kernel_t simd_row_kernel_for(globe_kernel_t kernel)
+{
+	switch (kernel) {
+	case globe_kernel_t::SSE41:
+		return draw_row_sse41<FORMAT>;
+	case globe_kernel_t::AVX2:
+		return draw_row_avx2<FORMAT>;
+	default:
+		return nullptr;
+	}
+}
+
+} // namespace
+
+row_kernel_t simd_row_kernel(globe_kernel_t kernel, globe_map_format_t map_format)
+{
+	switch (map_format) {
+	case globe_map_format_t::COLORED:
+		return simd_row_kernel_for<globe_map_format_t::COLORED>(kernel);
+	case globe_map_format_t::PACKED:
+		return simd_row_kernel_for<globe_map_format_t::PACKED>(kernel);
+	case globe_map_format_t::TILED:
+		return simd_row_kernel_for<globe_map_format_t::TILED>(kernel);
+	default:
+		return simd_row_kernel_for<globe_map_format_t::RAW>(kernel);
+	}
+}
+
+#else
+
+globe_kernel_t best_globe_kernel()
+{
+	return globe_kernel_t::SCALAR;
+}
+
+row_kernel_t simd_row_kernel(globe_kernel_t, globe_map_format_t)
+{
+	return nullptr;
+}
+
+#endif
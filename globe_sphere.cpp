@@ -0,0 +1,495 @@
+#include "globe_sphere.h"
+#include "globe_kernel.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+/*
+ *  The sphere closest to the shipped tables (scale 1): 99 latitude rings a quadrant,
+ *  a radius of 63.5 pixels (pair i at x = i) and pixels 1.155 times as high as wide,
+ *  which leaves 55 globe lines. It shapes the finer tables in between the shipped values.
+ */
+constexpr int RINGS_PER_QUADRANT = MAX_TILT + 1;
+constexpr double RADIUS = 63.5;
+constexpr double PIXEL_ASPECT = 1.155;
+
+constexpr double PI = 3.14159265358979323846;
+
+// the tilt table entries decoded like decode_tilt_entry, offset1 can be > 0xff
+constexpr int32_t SPHERE_TILT_OFFSET_MASK = 0xffff;
+constexpr int32_t SPHERE_TILT_LO_NEGATIVE = 0x10000;
+constexpr int32_t SPHERE_TILT_NEGATIVE = 0x20000;
+
+int round_to_int(double value)
+{
+	return int(std::floor(value + 0.5));
+}
+
+/*
+ *  A table value at fine sample (a, b) of a table scale times as fine as the shipped one.
+ *  residual(A, B) is the shipped value at coarse sample (A, B) in fine units less the model
+ *  there, it clamps A and B to the shipped table. Sample (A * scale, B * scale) gets the
+ *  shipped value, in between the model follows the sphere and the residual is bilinear.
+ */
+template <typename model_t, typename residual_t>
+double refine_sphere_value(int a, int b, int scale, const model_t& model, const residual_t& residual)
+{
+	const int coarse_a = a / scale;
+	const int coarse_b = b / scale;
+	const double ta = double(a % scale) / scale;
+	const double tb = double(b % scale) / scale;
+
+	double value = (1 - ta) * (1 - tb) * residual(coarse_a, coarse_b);
+	if (tb != 0) {
+		value += (1 - ta) * tb * residual(coarse_a, coarse_b + 1);
+	}
+	if (ta != 0) {
+		value += ta * (1 - tb) * residual(coarse_a + 1, coarse_b);
+		if (tb != 0) {
+			value += ta * tb * residual(coarse_a + 1, coarse_b + 1);
+		}
+	}
+	return model(a, b) + value;
+}
+
+// rows in framebuffer order: the lines of the northern hemisphere from the pole, then the southern ones
+void compile_sphere_rows(globe_sphere_tables_t& tables, const std::vector<std::vector<int16_t>>& lines)
+{
+	const int line_count = int(lines.size());
+	tables.height = line_count * 2 - 1;
+	tables.width = tables.slice_count * 2;
+
+	const auto add_row = [&](const std::vector<int16_t>& line, int y, bool is_north) {
+		tables.rows.push_back({ tables.slice_count, y, int(tables.gd_vals.size()), int(line.size()) });
+		for (int16_t gd_val : line) {
+			tables.gd_vals.push_back(is_north ? gd_val : int16_t(-gd_val));
+		}
+	};
+
+	for (int line = line_count - 1; line >= 0; --line) {
+		add_row(lines[line], line_count - 1 - line, true);
+	}
+	for (int line = 1; line < line_count; ++line) {
+		add_row(lines[line], line_count - 1 + line, false);
+	}
+}
+
+// like precalculate_globe_tilt_lookup_table, decoded
+void make_sphere_tilt_table(std::vector<int32_t>& table, int tilt, int max_tilt)
+{
+	table.resize(size_t(max_tilt) * 2);
+	tilt = std::min(std::max(tilt, -max_tilt), max_tilt);
+
+	size_t i = 0;
+	if (tilt > 0) {
+		int v = tilt - max_tilt;
+		do {
+			--v;
+			table[i++] = -v | SPHERE_TILT_LO_NEGATIVE;
+		} while (i != table.size() && v > -max_tilt);
+	}
+
+	if (i != table.size()) {
+		int v = tilt + max_tilt - int(i);
+		do {
+			table[i++] = v--;
+		} while (i != table.size() && v >= 0);
+	}
+
+	if (i != table.size()) {
+		int v = 1;
+		do {
+			table[i++] = v++ | SPHERE_TILT_NEGATIVE;
+		} while (i != table.size() && v <= max_tilt);
+	}
+
+	if (i != table.size()) {
+		int v = -max_tilt;
+		do {
+			table[i++] = -v | (v < 0 ? SPHERE_TILT_LO_NEGATIVE : 0) | SPHERE_TILT_NEGATIVE;
+			++v;
+		} while (i != table.size() && v <= 0);
+	}
+}
+
+// what the per pixel code relies on, so it does not need to check
+void check_sphere_tables(const globe_sphere_tables_t& tables)
+{
+	const int entry_count = tables.max_tilt + 1;
+	assert_throw(tables.scale >= 1 && tables.max_tilt >= 1 && tables.max_tilt < SPHERE_TILT_OFFSET_MASK);
+	assert_throw(int(tables.rings.size()) == entry_count);
+	assert_throw(tables.slice_values.size() == size_t(tables.slice_count) * entry_count);
+
+	for (int entry = 0; entry != entry_count; ++entry) {
+		const auto& ring = tables.rings[entry];
+		assert_throw((entry == 0) == (ring.unk0 == 0) && ring.unk1 >= 1);
+		assert_throw(tables.map_center - ring.unk0 >= 0 && tables.map_center + ring.unk0 + ring.unk1 * 2 <= tables.map_size);
+	}
+	// the rotation fixed point math is 32 bit
+	assert_throw(uint64_t(0xffff) * 2 * tables.rings[0].unk1 <= 0xffffffffu);
+
+	for (uint32_t value : tables.slice_values) {
+		const uint32_t entry = value & 0xffff;
+		assert_throw(entry < uint32_t(entry_count) && (value >> 16) <= uint32_t(tables.rings[entry].unk1));
+	}
+
+	for (const auto& row : tables.rows) {
+		assert_throw(row.count <= tables.slice_count && row.x - row.count >= 0 && row.x + row.count <= tables.width);
+		assert_throw(row.y >= 0 && row.y < tables.height);
+		assert_throw(row.first_pixel >= 0 && size_t(row.first_pixel) + row.count <= tables.gd_vals.size());
+	}
+	// the tilt table has 2 * max_tilt entries
+	for (int16_t gd_val : tables.gd_vals) {
+		assert_throw(gd_val >= -tables.max_tilt && gd_val < tables.max_tilt);
+	}
+}
+
+}
+
+globe_sphere_tables_t shipped_globe_sphere_tables()
+{
+	const globe_program_t& program = globe_program();
+	const framebuffer_rect_t& rect = globe_bounding_rect();
+	const globe_rotation_lookup_table_t& rotation_lookup_table = base_globe_rotation_lookup_table();
+
+	globe_sphere_tables_t tables{};
+	tables.scale = 1;
+	tables.max_tilt = MAX_TILT;
+	tables.slice_count = 64;
+	tables.width = rect.w;
+	tables.height = rect.h;
+
+	for (const auto& row : program.rows) {
+		tables.rows.push_back({ row.x - rect.x, row.y - rect.y, row.first_pixel, row.count });
+	}
+	tables.gd_vals.assign(program.gd_vals.begin(), program.gd_vals.end());
+
+	for (int slice = 0; slice != tables.slice_count; ++slice) {
+		for (int offset1 = 0; offset1 != MAX_TILT + 1; ++offset1) {
+			const uint16_t value = program.slice_values[slice * SLICE_VALUE_COUNT + offset1];
+			tables.slice_values.push_back(uint32_t(value & 0xff) | (uint32_t(value >> 8) << 16));
+		}
+	}
+
+	for (const auto& entry : rotation_lookup_table) {
+		tables.rings.push_back({ entry.unk0, entry.unk1 });
+	}
+	tables.map_center = MAP_CENTER_OFS;
+	tables.map_size = int(MAP_BIN_SIZE);
+	return tables;
+}
+
+globe_sphere_tables_t synthesize_globe_sphere_tables(int scale)
+{
+	assert_throw(scale >= 1);
+
+	const globe_sphere_tables_t shipped = shipped_globe_sphere_tables();
+	const int shipped_entry_count = shipped.max_tilt + 1;
+
+	globe_sphere_tables_t tables{};
+	tables.scale = scale;
+	tables.max_tilt = RINGS_PER_QUADRANT * scale - 1;
+
+	// one ring (and one step of the tilt table) in radians
+	const double ring_angle = PI / 2 / (RINGS_PER_QUADRANT * scale);
+	const int entry_count = tables.max_tilt + 1;
+
+	// the ring lengths in between the shipped ones, down to 0 past the last one
+	const auto shipped_unk1 = [&](int entry) { return entry < shipped_entry_count ? shipped.rings[entry].unk1 : 0; };
+
+	// the rings go around the map one after the other, the equator first
+	int32_t ring_offset = 0;
+	for (int entry = 0; entry != entry_count; ++entry) {
+		const int step = entry % scale;
+		const int32_t unk1 = std::max(1, shipped_unk1(entry / scale) * (scale - step) + shipped_unk1(entry / scale + 1) * step);
+		tables.rings.push_back({ ring_offset, unk1 });
+		ring_offset += unk1 * 2;
+	}
+	const auto& last_ring = tables.rings.back();
+	tables.map_center = last_ring.unk0 + last_ring.unk1 * 2;
+	tables.map_size = tables.map_center * 2 + 1;
+
+	// in pixels of scale 1, pair i of a row is at x = i / scale
+	const double radius = RADIUS;
+	tables.slice_count = shipped.slice_count * scale;
+
+	// table0/table1: the ring and column seen at slice x, offset1 rings up its circle
+	const auto model_slice = [&](int slice) { return std::min(double(slice) / scale / radius, 1.0); };
+	const auto model_table0 = [&](int slice, int offset1) {
+		const double x = model_slice(slice);
+		return std::asin(std::sqrt(1 - x * x) * std::sin(offset1 * ring_angle)) / ring_angle;
+	};
+	// table1 as a fraction of its ring, the ring lengths of the two scales differ
+	const auto model_table1 = [&](int slice, int offset1) {
+		const double x = model_slice(slice);
+		return std::atan2(x, std::sqrt(1 - x * x) * std::cos(offset1 * ring_angle)) / PI;
+	};
+	const auto shipped_slice_value = [&](int slice, int offset1) {
+		return shipped.slice_values[size_t(slice) * shipped_entry_count + offset1];
+	};
+
+	for (int slice = 0; slice != tables.slice_count; ++slice) {
+		for (int offset1 = 0; offset1 != entry_count; ++offset1) {
+			const double table0 = refine_sphere_value(slice, offset1, scale, model_table0, [&](int shipped_slice, int shipped_offset1) {
+				shipped_slice = std::min(shipped_slice, shipped.slice_count - 1);
+				shipped_offset1 = std::min(shipped_offset1, shipped.max_tilt);
+				return scale * double(shipped_slice_value(shipped_slice, shipped_offset1) & 0xffff) - model_table0(shipped_slice * scale, shipped_offset1 * scale);
+			});
+			const int entry = std::min(std::max(round_to_int(table0), 0), tables.max_tilt);
+
+			const double table1 = refine_sphere_value(slice, offset1, scale, model_table1, [&](int shipped_slice, int shipped_offset1) {
+				shipped_slice = std::min(shipped_slice, shipped.slice_count - 1);
+				shipped_offset1 = std::min(shipped_offset1, shipped.max_tilt);
+				const uint32_t value = shipped_slice_value(shipped_slice, shipped_offset1);
+				return double(value >> 16) / shipped.rings[value & 0xffff].unk1 - model_table1(shipped_slice * scale, shipped_offset1 * scale);
+			});
+			const int32_t unk1 = tables.rings[entry].unk1;
+			tables.slice_values.push_back(uint32_t(entry) | (uint32_t(std::min(std::max(round_to_int(table1 * unk1), 0), int(unk1))) << 16));
+		}
+	}
+
+	// the globe lines of the shipped northern hemisphere, the equator first
+	const int shipped_line_count = (shipped.height + 1) / 2;
+	const auto shipped_line = [&](int line) -> const globe_sphere_tables_t::row_t& {
+		return shipped.rows[shipped_line_count - 1 - line];
+	};
+	const auto shipped_count = [&](int line) { return line < shipped_line_count ? shipped_line(line).count : 0; };
+
+	// as many lines as the sphere has, as long as every scale-th one is a shipped one
+	const int line_count = std::min(std::max(int(std::ceil(radius * scale / PIXEL_ASPECT)), (shipped_line_count - 1) * scale + 1), shipped_line_count * scale);
+
+	// gd_val is how many rings up the circle of its slice a pixel is
+	const auto model_gd_val = [&](int line, int slice) {
+		const double x = double(slice) / scale;
+		const double circle = radius * radius - x * x;
+		const double y = line * PIXEL_ASPECT / scale;
+		return std::asin(circle > y * y ? y / std::sqrt(circle) : 1.0) / ring_angle;
+	};
+
+	std::vector<std::vector<int16_t>> lines;
+	for (int line = 0; line != line_count; ++line) {
+		const int step = line % scale;
+		const int count = shipped_count(line / scale) * (scale - step) + shipped_count(line / scale + 1) * step;
+
+		std::vector<int16_t> gd_vals;
+		for (int slice = 0; slice != count; ++slice) {
+			const double gd_val = refine_sphere_value(line, slice, scale, model_gd_val, [&](int shipped_line_index, int shipped_slice) {
+				shipped_line_index = std::min(shipped_line_index, shipped_line_count - 1);
+				const auto& row = shipped_line(shipped_line_index);
+				shipped_slice = std::min(shipped_slice, row.count - 1);
+				return scale * double(shipped.gd_vals[row.first_pixel + shipped_slice]) - model_gd_val(shipped_line_index * scale, shipped_slice * scale);
+			});
+			gd_vals.push_back(int16_t(std::min(std::max(round_to_int(gd_val), 0), tables.max_tilt - 1)));
+		}
+		lines.push_back(std::move(gd_vals));
+	}
+	compile_sphere_rows(tables, lines);
+
+	// every scale-th value is a shipped one
+	const globe_sphere_tables_t coarse = downsample_globe_sphere_tables(tables, scale);
+	const globe_sphere_tables_match_t match = compare_globe_sphere_tables(coarse, shipped);
+	assert_throw(match.contour == 1 && match.gd_vals == 1 && match.table0 == 1 && match.table1 == 1 && match.rings == 1);
+	assert_throw(coarse.width == shipped.width && coarse.height == shipped.height && coarse.map_center == shipped.map_center);
+
+	return tables;
+}
+
+globe_sphere_tables_t downsample_globe_sphere_tables(const globe_sphere_tables_t& tables, int factor)
+{
+	assert_throw(factor >= 1 && tables.scale % factor == 0);
+
+	const auto downsample = [&](int value) { return round_to_int(double(value) / factor); };
+
+	globe_sphere_tables_t coarse{};
+	coarse.scale = tables.scale / factor;
+	coarse.max_tilt = (tables.max_tilt + 1) / factor - 1;
+	coarse.slice_count = (tables.slice_count + factor - 1) / factor;
+
+	int32_t ring_offset = 0;
+	for (int entry = 0; entry != coarse.max_tilt + 1; ++entry) {
+		const int32_t unk1 = downsample(tables.rings[size_t(entry) * factor].unk1);
+		coarse.rings.push_back({ ring_offset, unk1 });
+		ring_offset += unk1 * 2;
+	}
+	const auto& last_ring = coarse.rings.back();
+	coarse.map_center = last_ring.unk0 + last_ring.unk1 * 2;
+	coarse.map_size = coarse.map_center * 2 + 1;
+
+	for (int slice = 0; slice != coarse.slice_count; ++slice) {
+		for (int offset1 = 0; offset1 != coarse.max_tilt + 1; ++offset1) {
+			const uint32_t value = tables.slice_values[size_t(slice) * factor * (tables.max_tilt + 1) + size_t(offset1) * factor];
+			coarse.slice_values.push_back(uint32_t(downsample(value & 0xffff)) | (uint32_t(downsample(value >> 16)) << 16));
+		}
+	}
+
+	// every factor-th line from the equator, every factor-th pair from the center
+	const int line_count = (tables.height + 1) / 2;
+	std::vector<std::vector<int16_t>> lines;
+	for (int line = 0; line < line_count; line += factor) {
+		const auto& row = tables.rows[line_count - 1 - line];
+		std::vector<int16_t> gd_vals;
+		for (int slice = 0; slice < row.count; slice += factor) {
+			gd_vals.push_back(int16_t(downsample(tables.gd_vals[row.first_pixel + slice])));
+		}
+		lines.push_back(std::move(gd_vals));
+	}
+	compile_sphere_rows(coarse, lines);
+
+	return coarse;
+}
+
+globe_sphere_tables_t globe_sphere_tables(int scale)
+{
+	return synthesize_globe_sphere_tables(scale);
+}
+
+globe_sphere_tables_match_t compare_globe_sphere_tables(const globe_sphere_tables_t& a, const globe_sphere_tables_t& b)
+{
+	assert_throw(a.scale == b.scale);
+
+	globe_sphere_tables_match_t match{};
+
+	// rows by index, the pixel pairs both have
+	const size_t row_count = std::min(a.rows.size(), b.rows.size());
+	size_t same_rows = 0;
+	size_t pixels = 0;
+	size_t same_pixels = 0;
+	for (size_t r = 0; r != row_count; ++r) {
+		const auto& row_a = a.rows[r];
+		const auto& row_b = b.rows[r];
+		same_rows += (row_a.x == row_b.x && row_a.y == row_b.y && row_a.count == row_b.count) ? 1 : 0;
+		for (int i = 0; i != std::min(row_a.count, row_b.count); ++i) {
+			same_pixels += (a.gd_vals[row_a.first_pixel + i] == b.gd_vals[row_b.first_pixel + i]) ? 1 : 0;
+			++pixels;
+		}
+	}
+	match.contour = double(same_rows) / std::max(a.rows.size(), b.rows.size());
+	match.gd_vals = pixels ? double(same_pixels) / pixels : 0;
+
+	const int slice_count = std::min(a.slice_count, b.slice_count);
+	const int entry_count = std::min(a.max_tilt, b.max_tilt) + 1;
+	size_t same_table0 = 0;
+	size_t same_table1 = 0;
+	for (int slice = 0; slice != slice_count; ++slice) {
+		for (int offset1 = 0; offset1 != entry_count; ++offset1) {
+			const uint32_t value_a = a.slice_values[size_t(slice) * (a.max_tilt + 1) + offset1];
+			const uint32_t value_b = b.slice_values[size_t(slice) * (b.max_tilt + 1) + offset1];
+			same_table0 += ((value_a & 0xffff) == (value_b & 0xffff)) ? 1 : 0;
+			same_table1 += ((value_a >> 16) == (value_b >> 16)) ? 1 : 0;
+		}
+	}
+	const size_t values = size_t(std::max(a.slice_count, b.slice_count)) * (std::max(a.max_tilt, b.max_tilt) + 1);
+	match.table0 = double(same_table0) / values;
+	match.table1 = double(same_table1) / values;
+
+	size_t same_rings = 0;
+	for (int entry = 0; entry != entry_count; ++entry) {
+		same_rings += (a.rings[entry].unk0 == b.rings[entry].unk0 && a.rings[entry].unk1 == b.rings[entry].unk1) ? 1 : 0;
+	}
+	match.rings = double(same_rings) / (std::max(a.max_tilt, b.max_tilt) + 1);
+
+	return match;
+}
+
+std::vector<uint8_t> resample_globe_map(const globe_sphere_tables_t& tables, const uint8_t* map)
+{
+	const globe_rotation_lookup_table_t& rotation_lookup_table = base_globe_rotation_lookup_table();
+
+	std::vector<uint8_t> resampled(tables.map_size, 0);
+	for (int entry = 0; entry != tables.max_tilt + 1; ++entry) {
+		const auto& ring = tables.rings[entry];
+		const auto& source = rotation_lookup_table[std::min((entry + tables.scale / 2) / tables.scale, MAX_TILT)];
+		const int length = ring.unk1 * 2;
+		const int source_length = source.unk1 * 2;
+
+		for (int sign : { 1, -1 }) {
+			uint8_t* dst = &resampled[tables.map_center + sign * ring.unk0];
+			const uint8_t* src = &map[MAP_CENTER_OFS + sign * source.unk0];
+			for (int column = 0; column != length; ++column) {
+				dst[column] = src[int64_t(column) * source_length / length];
+			}
+		}
+	}
+	return resampled;
+}
+
+globe_sphere_renderer_t::globe_sphere_renderer_t(int scale)
+	: globe_sphere_renderer_t(globe_sphere_tables(scale), globe_assets().map)
+{
+}
+
+globe_sphere_renderer_t::globe_sphere_renderer_t(globe_sphere_tables_t tables, const uint8_t* map)
+	: sphere(std::move(tables))
+	, tilt_table_tilt(sphere.max_tilt + 1) // none yet
+	, entry_fp_hi(sphere.rings.size())
+	, rotation_class(-1)
+{
+	check_sphere_tables(sphere);
+
+	colored_map = resample_globe_map(sphere, map);
+	for (uint8_t& value : colored_map) {
+		value = kernel_pixel_color(value);
+	}
+}
+
+void globe_sphere_renderer_t::render(int16_t tilt, uint16_t rotation, uint8_t* dst, int dst_pitch)
+{
+	assert_throw(dst_pitch >= sphere.width);
+
+	// the same angle on the finer rings
+	const int sphere_tilt = std::min(std::max(int(tilt), -MAX_TILT), int(MAX_TILT)) * sphere.scale;
+	if (sphere_tilt != tilt_table_tilt) {
+		make_sphere_tilt_table(tilt_table, sphere_tilt, sphere.max_tilt);
+		tilt_table_tilt = sphere_tilt;
+	}
+
+	// precalculate_globe_rotation_lookup_table, one rotation class per column of the equator
+	const uint32_t class_count = uint32_t(sphere.rings[0].unk1) * 2;
+	const uint32_t dxax = (uint32_t(rotation) * class_count) & ~0xffffu;
+	if (int(dxax >> 16) != rotation_class) {
+		rotation_class = int(dxax >> 16);
+		entry_fp_hi[0] = rotation_class;
+		const uint32_t bx = uint16_t((dxax + 0x8000) / class_count);
+		for (size_t entry = 1; entry != sphere.rings.size(); ++entry) {
+			entry_fp_hi[entry] = int32_t((2 * bx * uint32_t(sphere.rings[entry].unk1)) >> 16);
+		}
+	}
+
+	const int entry_count = sphere.max_tilt + 1;
+	const uint8_t* const map = &colored_map[sphere.map_center];
+
+	// func2 -> func1 -> set_pixel_color, as kernel_pixel_pair
+	for (const auto& row : sphere.rows) {
+		const int16_t* gd_vals = &sphere.gd_vals[row.first_pixel];
+		uint8_t* right = &dst[row.y * dst_pitch + row.x];
+		uint8_t* left = right - 1;
+
+		for (int index = 0; index < row.count; ++index) {
+			const int32_t tilt_entry = tilt_table[sphere.max_tilt + gd_vals[index]];
+			const uint32_t slice_value = sphere.slice_values[size_t(index) * entry_count + (tilt_entry & SPHERE_TILT_OFFSET_MASK)];
+
+			const int entry = int(slice_value & 0xffff);
+			const auto& ring = sphere.rings[entry];
+			const int table1 = int(slice_value >> 16);
+
+			const int grlt_0 = (tilt_entry & SPHERE_TILT_NEGATIVE) ? -ring.unk0 : ring.unk0;
+			const int gd = (tilt_entry & SPHERE_TILT_LO_NEGATIVE) ? ring.unk1 - table1 : table1;
+			const int grlt_1 = ring.unk1 * 2;
+			const int fp_hi = entry_fp_hi[entry];
+
+			int left_ofs = fp_hi - gd;
+			if (left_ofs < 0) {
+				left_ofs += grlt_1;
+			}
+			int right_ofs = fp_hi + gd - grlt_1;
+			if (right_ofs < 0) {
+				right_ofs += grlt_1;
+			}
+
+			left[-index] = map[grlt_0 + left_ofs];
+			right[index] = map[grlt_0 + right_ofs];
+		}
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "globe_renderer.h"
+
+/*
+ *  The globe tables for a globe of scale times the original radius, so the table
+ *  driven per pixel code (func1/func2, no trigonometry) draws it natively instead
+ *  of scaling the 128 x 109 pixels up.
+ *  At scale k there are k times the latitude rings and slices, every ring is k times
+ *  as long and every table value k times as fine. The layout follows the shipped
+ *  tables, with wider types where the values no longer fit.
+ */
+struct globe_sphere_tables_t
+{
+	// a globe line compiled into framebuffer order, see globe_program_t::row_t
+	struct row_t
+	{
+		int x;           // the right pixel of pair 0, the left one is x - 1
+		int y;
+		int first_pixel; // into gd_vals
+		int count;
+	};
+
+	// GLOBE_ROTATION_LOOKUP_TABLE without the rotation dependent part
+	struct ring_t
+	{
+		int32_t unk0; // map offset of the ring from map_center, +- for the two hemispheres
+		int32_t unk1; // half the ring length
+	};
+
+	int scale;
+	int max_tilt;      // MAX_TILT at scale 1, rings of a hemisphere - 1
+	int slice_count;   // pixel pairs of the widest row
+	int width;         // of the globe bounding rect, the rows are relative to it
+	int height;
+
+	std::vector<row_t> rows;
+	// like globe_program_t::gd_vals, indices into the tilt table - max_tilt
+	std::vector<int16_t> gd_vals;
+	// [slice * (max_tilt + 1) + offset1]: table0 / 2 (the ring entry) | table1 << 16
+	std::vector<uint32_t> slice_values;
+	std::vector<ring_t> rings; // max_tilt + 1
+
+	int map_center; // MAP_CENTER_OFS at scale 1
+	int map_size;   // bytes the rings of the map need
+};
+
+// the shipped GLOBDATA.BIN/TABLAT.BIN tables in that layout (scale 1)
+globe_sphere_tables_t shipped_globe_sphere_tables();
+
+/*
+ *  The shipped tables refined to any scale >= 1: every scale-th ring, line, slice and
+ *  tilt step holds scale times the shipped value, the ones in between follow a sphere
+ *  fitted to the shipped tables. Downsampling them by scale gives the shipped tables
+ *  again, which is checked here, so scale 1 is the shipped tables.
+ */
+globe_sphere_tables_t synthesize_globe_sphere_tables(int scale);
+
+// every factor-th value of tables divided by factor, tables.scale / factor
+globe_sphere_tables_t downsample_globe_sphere_tables(const globe_sphere_tables_t& tables, int factor);
+
+// synthesize_globe_sphere_tables
+globe_sphere_tables_t globe_sphere_tables(int scale);
+
+// how many entries of a and b are equal, for tables of the same scale
+struct globe_sphere_tables_match_t
+{
+	double contour; // rows of the same place and length
+	double gd_vals; // pixel pairs of the rows both have
+	double table0;
+	double table1;
+	double rings;
+};
+
+globe_sphere_tables_match_t compare_globe_sphere_tables(const globe_sphere_tables_t& a, const globe_sphere_tables_t& b);
+
+/*
+ *  MAP.BIN resampled to the rings of tables (nearest ring and column),
+ *  at scale 1 the ring bytes are the ones of map.
+ */
+std::vector<uint8_t> resample_globe_map(const globe_sphere_tables_t& tables, const uint8_t* map);
+
+/*
+ *  Renders the globe of globe_sphere_tables(scale) into a width x height
+ *  bounding rect, from MAP.BIN resampled once on construction.
+ *  Same tilt and rotation as globe_renderer_t, the tilt is scaled to the finer rings.
+ *  The tables are checked once on construction, the per pixel code does not check.
+ */
+class globe_sphere_renderer_t
+{
+public:
+	explicit globe_sphere_renderer_t(int scale);
+	globe_sphere_renderer_t(globe_sphere_tables_t tables, const uint8_t* map);
+
+	int width() const { return sphere.width; }
+	int height() const { return sphere.height; }
+	const globe_sphere_tables_t& tables() const { return sphere; }
+
+	// dst holds height() lines of dst_pitch (>= width()) bytes, only the globe pixels are written
+	void render(int16_t tilt, uint16_t rotation, uint8_t* dst, int dst_pitch);
+
+private:
+	globe_sphere_tables_t sphere;
+	std::vector<uint8_t> colored_map; // kernel_pixel_color of the resampled map
+
+	std::vector<int32_t> tilt_table;  // decoded like kernel_tilt_table_t, 2 * max_tilt
+	int tilt_table_tilt;
+	std::vector<int32_t> entry_fp_hi; // per ring entry
+	int rotation_class;
+};
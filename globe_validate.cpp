@@ -0,0 +1,441 @@
+// Offline differential validator: every canonical pose against initial_port, no SDL needed:
+//   g++ -O2 -std=c++17 -pthread globe_validate.cpp globe_assets.cpp globe_renderer.cpp globe_frame_cache.cpp globe_geometry.cpp globe_simd.cpp worker_pool.cpp initial_port.cpp -o globe_validate
+//
+//   ./globe_validate --build golden.db [--shard i/n]     renders every pose with both implementations,
+//                                                        compares them and stores the reference hashes
+//   ./globe_validate --check golden.db [--shard i/n]     renders every pose and compares with the stored hashes,
+//                                                        the reference is not needed
+//   ./globe_validate --merge out.db shard0.db shard1.db  combines the databases of the shards
+//
+//   [--threads N] [--kernel checked|scalar|sse4.1|avx2|geometry|all] [--map-format raw|colored|packed|tiled|all] [--per-class K]
+//
+// Every selected kernel renders with every selected map format (CHECKED always reads the map
+// bytes), with the geometry cache off. geometry is the geometry cache path, which draws the same
+// for every kernel. --kernel and --map-format can be repeated, the default is the best kernel and
+// geometry with the COLORED map.
+//
+// The database is one 64 bit hash of the framebuffer per canonical pose (globe_pose_index order,
+// 0: not computed, e.g. by another shard) behind a small header, ~613 KB, in host byte order.
+
+#include "globe_renderer.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace initial_port
+{
+	void draw_frame(int16_t tilt, int16_t rotation, uint8_t* framebuffer);
+}
+
+namespace {
+
+constexpr char GOLDEN_MAGIC[8] = { 'G', 'L', 'O', 'B', 'E', 'D', 'B', '1' };
+
+using golden_t = std::vector<uint64_t>;
+
+// not cryptographic, just well mixed: 8 bytes per step
+uint64_t hash_framebuffer(const uint8_t* framebuffer)
+{
+	static_assert((FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT) % 8 == 0, "hashed in 8 byte words");
+
+	uint64_t h = 0x9e3779b97f4a7c15ull;
+	for (int i = 0; i != FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT; i += 8) {
+		uint64_t word;
+		memcpy(&word, framebuffer + i, 8);
+		h ^= word * 0xff51afd7ed558ccdull;
+		h = (h << 31 | h >> 33) * 0xc4ceb9fe1a85ec53ull;
+	}
+	h ^= h >> 29;
+
+	// 0 marks a missing entry
+	return h ? h : 1;
+}
+
+bool read_golden(const std::string& path, golden_t& golden)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) {
+		fprintf(stderr, "can't read %s\n", path.c_str());
+		return false;
+	}
+
+	char magic[8];
+	uint32_t pose_count = 0;
+	golden.assign(GLOBE_POSE_COUNT, 0);
+	const bool ok = fread(magic, 1, 8, file) == 8 && memcmp(magic, GOLDEN_MAGIC, 8) == 0 &&
+		fread(&pose_count, 4, 1, file) == 1 && pose_count == GLOBE_POSE_COUNT &&
+		fread(golden.data(), 8, golden.size(), file) == golden.size();
+	fclose(file);
+
+	if (!ok) {
+		fprintf(stderr, "%s is not a golden database for %d poses\n", path.c_str(), GLOBE_POSE_COUNT);
+	}
+	return ok;
+}
+
+bool write_golden(const std::string& path, const golden_t& golden)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file) {
+		fprintf(stderr, "can't write %s\n", path.c_str());
+		return false;
+	}
+
+	const uint32_t pose_count = GLOBE_POSE_COUNT;
+	const bool ok = fwrite(GOLDEN_MAGIC, 1, 8, file) == 8 && fwrite(&pose_count, 4, 1, file) == 1 &&
+		fwrite(golden.data(), 8, golden.size(), file) == golden.size();
+	return (fclose(file) == 0) && ok;
+}
+
+// how one renderer of the run draws
+struct render_path_t {
+	globe_kernel_t kernel;
+	globe_map_format_t map_format;
+	bool geometry;
+};
+
+struct options_t {
+	std::string build_path;
+	std::string check_path;
+	std::string merge_path;
+	std::vector<std::string> merge_inputs;
+	int shard = 0;
+	int shard_count = 1;
+	unsigned thread_count = 0;
+	std::vector<globe_kernel_t> kernels;
+	bool geometry = false;
+	std::vector<globe_map_format_t> map_formats;
+	std::vector<render_path_t> paths; // from the three above
+	int per_class = 1;
+};
+
+const char* kernel_name(globe_kernel_t kernel)
+{
+	switch (kernel) {
+	case globe_kernel_t::CHECKED: return "checked";
+	case globe_kernel_t::SCALAR:  return "scalar";
+	case globe_kernel_t::SSE41:   return "sse4.1";
+	case globe_kernel_t::AVX2:    return "avx2";
+	}
+	return "?";
+}
+
+const char* map_format_name(globe_map_format_t map_format)
+{
+	switch (map_format) {
+	case globe_map_format_t::RAW:     return "raw";
+	case globe_map_format_t::COLORED: return "colored";
+	case globe_map_format_t::PACKED:  return "packed";
+	case globe_map_format_t::TILED:   return "tiled";
+	}
+	return "?";
+}
+
+std::string path_name(const render_path_t& path)
+{
+	if (path.kernel == globe_kernel_t::CHECKED && !path.geometry) {
+		return kernel_name(path.kernel);
+	}
+	return std::string(path.geometry ? "geometry" : kernel_name(path.kernel)) + "-" + map_format_name(path.map_format);
+}
+
+bool parse_kernels(const std::string& name, options_t& options)
+{
+	bool found = false;
+	for (globe_kernel_t kernel : { globe_kernel_t::CHECKED, globe_kernel_t::SCALAR, globe_kernel_t::SSE41, globe_kernel_t::AVX2 }) {
+		if (int(kernel) > int(best_globe_kernel())) {
+			continue;
+		}
+		if (name == "all" || name == kernel_name(kernel)) {
+			if (std::find(options.kernels.begin(), options.kernels.end(), kernel) == options.kernels.end()) {
+				options.kernels.push_back(kernel);
+			}
+			found = true;
+		}
+	}
+	if (name == "all" || name == "geometry") {
+		options.geometry = true;
+		found = true;
+	}
+	return found;
+}
+
+bool parse_map_formats(const std::string& name, std::vector<globe_map_format_t>& map_formats)
+{
+	bool found = false;
+	for (globe_map_format_t map_format : { globe_map_format_t::RAW, globe_map_format_t::COLORED, globe_map_format_t::PACKED, globe_map_format_t::TILED }) {
+		if (name == "all" || name == map_format_name(map_format)) {
+			if (std::find(map_formats.begin(), map_formats.end(), map_format) == map_formats.end()) {
+				map_formats.push_back(map_format);
+			}
+			found = true;
+		}
+	}
+	return found;
+}
+
+// every kernel with every map format, CHECKED once
+void make_render_paths(options_t& options)
+{
+	if (options.kernels.empty() && !options.geometry) {
+		options.kernels.push_back(best_globe_kernel());
+		options.geometry = true;
+	}
+	if (options.map_formats.empty()) {
+		options.map_formats.push_back(globe_map_format_t::COLORED);
+	}
+
+	for (globe_kernel_t kernel : options.kernels) {
+		if (kernel == globe_kernel_t::CHECKED) {
+			options.paths.push_back({ kernel, globe_map_format_t::RAW, false });
+			continue;
+		}
+		for (globe_map_format_t map_format : options.map_formats) {
+			options.paths.push_back({ kernel, map_format, false });
+		}
+	}
+	if (options.geometry) {
+		for (globe_map_format_t map_format : options.map_formats) {
+			options.paths.push_back({ best_globe_kernel(), map_format, true });
+		}
+	}
+}
+
+bool parse_options(int argc, char** argv, options_t& options)
+{
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool has_value = i + 1 < argc;
+
+		if (arg == "--build" && has_value) {
+			options.build_path = argv[++i];
+		} else if (arg == "--check" && has_value) {
+			options.check_path = argv[++i];
+		} else if (arg == "--merge" && has_value) {
+			options.merge_path = argv[++i];
+			while (i + 1 < argc && argv[i + 1][0] != '-') {
+				options.merge_inputs.push_back(argv[++i]);
+			}
+		} else if (arg == "--shard" && has_value) {
+			if (sscanf(argv[++i], "%d/%d", &options.shard, &options.shard_count) != 2) {
+				return false;
+			}
+		} else if (arg == "--threads" && has_value) {
+			options.thread_count = unsigned(atoi(argv[++i]));
+		} else if (arg == "--kernel" && has_value) {
+			if (!parse_kernels(argv[++i], options)) {
+				return false;
+			}
+		} else if (arg == "--map-format" && has_value) {
+			if (!parse_map_formats(argv[++i], options.map_formats)) {
+				return false;
+			}
+		} else if (arg == "--per-class" && has_value) {
+			options.per_class = atoi(argv[++i]);
+		} else {
+			return false;
+		}
+	}
+
+	const int modes = !options.build_path.empty() + !options.check_path.empty() + !options.merge_path.empty();
+	return modes == 1 && options.shard_count >= 1 && options.shard >= 0 && options.shard < options.shard_count &&
+		options.per_class >= 1;
+}
+
+// the k-th of count rotations spread over a rotation class, k = 0 is the representative
+uint16_t rotation_in_class(int rotation_class, int k, int count)
+{
+	const int first = (rotation_class * 65536 + GLOBE_ROTATION_CLASS_COUNT - 1) / GLOBE_ROTATION_CLASS_COUNT;
+	const int last = ((rotation_class + 1) * 65536 + GLOBE_ROTATION_CLASS_COUNT - 1) / GLOBE_ROTATION_CLASS_COUNT - 1;
+	return uint16_t(first + (count > 1 ? (last - first) * k / (count - 1) : 0));
+}
+
+struct mismatch_t {
+	int pose_index;
+	uint16_t rotation;
+	size_t path; // into options_t::paths
+};
+
+int merge(const options_t& options)
+{
+	golden_t merged(GLOBE_POSE_COUNT, 0);
+
+	for (const std::string& path : options.merge_inputs) {
+		golden_t golden;
+		if (!read_golden(path, golden)) {
+			return 1;
+		}
+
+		for (int i = 0; i != GLOBE_POSE_COUNT; ++i) {
+			if (!golden[i]) {
+				continue;
+			}
+			if (merged[i] && merged[i] != golden[i]) {
+				const globe_pose_t pose = globe_pose_from_index(i);
+				fprintf(stderr, "%s disagrees on tilt=%d rotation=%u\n", path.c_str(), globe_pose_tilt(pose), globe_pose_rotation(pose));
+				return 1;
+			}
+			merged[i] = golden[i];
+		}
+	}
+
+	int missing = 0;
+	for (uint64_t h : merged) {
+		missing += (h == 0);
+	}
+	if (missing) {
+		printf("%d of %d poses are not in any input\n", missing, GLOBE_POSE_COUNT);
+	}
+
+	return write_golden(options.merge_path, merged) ? 0 : 1;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	options_t options;
+	if (!parse_options(argc, argv, options)) {
+		fprintf(stderr, "usage: %s --build FILE | --check FILE | --merge OUT IN...\n"
+			"         [--shard i/n] [--threads N] [--kernel checked|scalar|sse4.1|avx2|geometry|all]\n"
+			"         [--map-format raw|colored|packed|tiled|all] [--per-class K]\n", argv[0]);
+		return 1;
+	}
+
+	if (!options.merge_path.empty()) {
+		return merge(options);
+	}
+
+	const bool build = !options.build_path.empty();
+	golden_t golden(GLOBE_POSE_COUNT, 0);
+	if (!build && !read_golden(options.check_path, golden)) {
+		return 1;
+	}
+
+	make_render_paths(options);
+	if (options.thread_count == 0) {
+		options.thread_count = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// this shard's poses, handed out in chunks of one tilt class (or less at the shard edges)
+	const int first_pose = int(int64_t(GLOBE_POSE_COUNT) * options.shard / options.shard_count);
+	const int end_pose = int(int64_t(GLOBE_POSE_COUNT) * (options.shard + 1) / options.shard_count);
+	const int chunk_count = (end_pose - first_pose + GLOBE_ROTATION_CLASS_COUNT - 1) / GLOBE_ROTATION_CLASS_COUNT;
+
+	// initial_port keeps its tables in globals, only one thread can run it at a time
+	std::mutex reference_mutex;
+
+	std::mutex result_mutex;
+	std::vector<mismatch_t> mismatches;
+	int missing = 0;
+	int64_t frames = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	worker_pool_t pool(options.thread_count);
+	pool.run(chunk_count, [&](int chunk) {
+		const int chunk_first = first_pose + chunk * GLOBE_ROTATION_CLASS_COUNT;
+		const int chunk_end = std::min(chunk_first + GLOBE_ROTATION_CLASS_COUNT, end_pose);
+
+		// with the geometry cache on, render() only uses the kernel for the first frame of a tilt
+		std::vector<globe_renderer_t> renderers(options.paths.size());
+		for (size_t r = 0; r != renderers.size(); ++r) {
+			const render_path_t& path = options.paths[r];
+			renderers[r].set_kernel(path.kernel);
+			renderers[r].set_map_format(path.map_format);
+			renderers[r].set_geometry_cache_size(path.geometry ? 1 : 0);
+		}
+		int geometry_tilt_class = -1;
+
+		std::vector<uint8_t> framebuffer(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT);
+		std::vector<uint8_t> reference(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT);
+		std::vector<mismatch_t> chunk_mismatches;
+		int chunk_missing = 0;
+		int64_t chunk_frames = 0;
+
+		for (int pose_index = chunk_first; pose_index != chunk_end; ++pose_index) {
+			const globe_pose_t pose = globe_pose_from_index(pose_index);
+			const int16_t tilt = globe_pose_tilt(pose);
+
+			if (build) {
+				std::fill(reference.begin(), reference.end(), uint8_t(0));
+				{
+					std::lock_guard<std::mutex> lock(reference_mutex);
+					initial_port::draw_frame(tilt, int16_t(globe_pose_rotation(pose)), reference.data());
+				}
+				golden[pose_index] = hash_framebuffer(reference.data());
+			} else if (!golden[pose_index]) {
+				++chunk_missing;
+				continue;
+			}
+
+			// the geometry is only built on the second frame of a tilt, draw the first one aside
+			// so that the geometry path draws every checked frame
+			if (pose.tilt_class != geometry_tilt_class) {
+				for (size_t r = 0; r != renderers.size(); ++r) {
+					if (options.paths[r].geometry) {
+						renderers[r].invalidate();
+						renderers[r].render(tilt, globe_pose_rotation(pose), framebuffer.data());
+					}
+				}
+				geometry_tilt_class = pose.tilt_class;
+			}
+
+			for (int k = 0; k != options.per_class; ++k) {
+				const uint16_t rotation = rotation_in_class(pose.rotation_class, k, options.per_class);
+
+				for (size_t r = 0; r != renderers.size(); ++r) {
+					std::fill(framebuffer.begin(), framebuffer.end(), uint8_t(0));
+					renderers[r].invalidate();
+					renderers[r].render(tilt, rotation, framebuffer.data());
+					++chunk_frames;
+
+					if (hash_framebuffer(framebuffer.data()) != golden[pose_index]) {
+						chunk_mismatches.push_back({ pose_index, rotation, r });
+					}
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(result_mutex);
+		mismatches.insert(mismatches.end(), chunk_mismatches.begin(), chunk_mismatches.end());
+		missing += chunk_missing;
+		frames += chunk_frames;
+	});
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("paths:");
+	for (const render_path_t& path : options.paths) {
+		printf(" %s", path_name(path).c_str());
+	}
+	printf("\n");
+
+	std::sort(mismatches.begin(), mismatches.end(), [](const mismatch_t& a, const mismatch_t& b) { return a.pose_index < b.pose_index; });
+	for (size_t i = 0; i != mismatches.size() && i != 20; ++i) {
+		const mismatch_t& m = mismatches[i];
+		printf("mismatch: tilt=%d rotation=%u path=%s\n", globe_pose_tilt(globe_pose_from_index(m.pose_index)), m.rotation, path_name(options.paths[m.path]).c_str());
+	}
+
+	printf("shard %d/%d: poses %d..%d, %lld frames on %u threads in %.2f s, %zu mismatches",
+		options.shard, options.shard_count, first_pose, end_pose - 1, (long long)frames, options.thread_count, seconds, mismatches.size());
+	if (missing) {
+		printf(", %d poses not in the database", missing);
+	}
+	printf("\n");
+
+	if (build && !write_golden(options.build_path, golden)) {
+		return 1;
+	}
+
+	// a pose that could not be checked fails the run as well
+	return (mismatches.empty() && missing == 0) ? 0 : 2;
+}
@@ -10,14 +10,12 @@
 #include <cstdio>
 #include <cmath>
 
+// the assets are shared with the renderer
+#include "globe_assets.h"
+
 namespace initial_port
 {
 
-#include "GLOBDATA.BIN.inc"
-#include "MAP.BIN.inc"
-#include "PAL.BIN.inc"
-#include "TABLAT.BIN.inc"
-
 uint16_t     globe_rotation_lookup_table[396];
 uint16_t     globe_tilt_lookup_table[196];
 
@@ -109,8 +107,8 @@ void precalculate_globe_tilt_lookup_table(int16_t globe_tilt) {
 }
 
 void draw_globe(uint8_t *framebuffer) {
-	const uint8_t  *globdata = GLOBDATA_BIN;
-	const uint8_t  *map      = MAP_BIN;
+	const uint8_t  *globdata = globe_assets().globdata;
+	const uint8_t  *map      = globe_assets().map;
 
 	uint16_t cs_1CA8 = 1;    // offset into globdata
 	uint16_t cs_1CA6 = 1;    // offset into globdata
@@ -268,6 +266,7 @@ void draw_globe(uint8_t *framebuffer) {
 }
 
 void draw_frame(int16_t tilt, int16_t rotation, uint8_t* framebuffer) {
+	const uint8_t* TABLAT_BIN = globe_assets().tablat;
 	for (int i = 0; i != 396; i++) {
 		uint16_t u = (TABLAT_BIN[2*i + 0] << 0) + (TABLAT_BIN[2*i+ 1 ] << 8);
 		globe_rotation_lookup_table[i] = u;
@@ -1,470 +1,124 @@
 #include <cassert>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <array>
+#include <memory>
 #include <string>
 #include <vector>
 
-// globe dimensions: 128 x 109 pixel
-//   128 = (left: 96, right : 96)
-//	 109 = 
-//     top: 55 (northern hemisphere, full globe_lines starting from 0)
-//     bottom: 54 (southern hemisphere, globe_lines starting from 1)
-
 #include <SDL/SDL.h> // vcpkg install sdl1:x86-windows
 #undef main
 
 unsigned resolution_factor = 5; // 1=320x200, 2=640x40, 3=1280x800, ...
+unsigned render_thread_count = 1; // > 1: render the globe rows on a worker pool (native only)
+size_t frame_cache_budget = 32 << 20; // > 0: keep rendered frames (~2900 in 32 MB) for revisited poses (native only)
+bool paletted_screen = false; // true: 8-bit screen surface, the palette goes to SDL_SetColors and palette changes need no redraw
+bool pipelined_rendering = false; // true: render on a separate thread while this one samples input and presents (native only)
+unsigned target_fps = 0; // > 0: pace the frames to this rate, 0: as fast as the poses change (native only)
+const char* asset_directory = nullptr; // set: GLOBDATA.BIN, MAP.BIN, PAL.BIN and TABLAT.BIN are mapped from there instead of the embedded ones, R reloads them (native only)
+bool show_map_cell = true; // true: the window title shows the MAP.BIN byte under the mouse (native, not pipelined)
+unsigned shadow_sample_interval = 0; // > 0: COMPARE_WITH_INITAL_CODE checks every Nth frame on a background thread and only logs mismatches (native only), 0: every frame, throws
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
-#include "GLOBDATA.BIN.inc"
-#include "MAP.BIN.inc"
-#include "PAL.BIN.inc"
-#include "TABLAT.BIN.inc"
-
-constexpr int FRAMEBUFFER_WIDTH = 320;
-constexpr int FRAMEBUFFER_HEIGHT = 200;
+#include "globe_renderer.h"
+#include "frame_scheduler.h"
+#include "globe_pipeline.h"
+#include "globe_presenter.h"
+#include "shadow_verifier.h"
 
 SDL_Surface *screen = NULL;
 std::array<uint8_t, FRAMEBUFFER_WIDTH* FRAMEBUFFER_HEIGHT> framebuffer;
 int          frame = 0;
 
-#define assert_throw(CONDITION) \
-  if( !(CONDITION) ) \
-  { \
-    printf("line: %i\n", __LINE__); \
-    assert(false); \
-	throw 0xdeadbeef; \
-  }
-
+globe_renderer_t renderer;
+globe_presenter_t presenter;
 
-struct rotation_lookup_table_entry_t {
-	uint16_t unk0;
-	uint16_t unk1;
-	uint16_t fp_hi;
-	uint16_t fp_lo;
+struct pos_t {
+	int16_t tilt{};
+	int16_t rotation{};
 };
-static_assert(sizeof(rotation_lookup_table_entry_t) == 8, "wrong size");
-
-constexpr int MAX_TILT = 98;
-using globe_rotation_lookup_table_t = std::array<rotation_lookup_table_entry_t, MAX_TILT+1>;
-globe_rotation_lookup_table_t globe_rotation_lookup_table;
-std::array<uint16_t, MAX_TILT*2> globe_tilt_lookup_table;
 
-inline
-uint16_t hi(uint32_t v) {
-	return (v >> 16) & 0xffff;
-}
-
-inline
-uint16_t lo(uint32_t v) {
-	return (v >> 0) & 0xffff;
-}
-
-inline
-int8_t hi(int16_t v) {
-	return v >> 8;
-}
+struct draw_params_t {
+	int16_t  tilt{};
+	uint16_t rotation{};
+};
 
 inline
-int8_t lo(int16_t v) {
-	return v & 0xff;
-}
-
-/*
- *  globe_rotation is value from 0x0000 - 0xffff.
- *  Think of it as the fractional part of a 16.16 fixed point number.
- */
-void precalculate_globe_rotation_lookup_table(uint16_t globe_rotation) {
-	constexpr uint32_t MAGIC_VALUE = 398; // (200-1)*2?
-
-	uint32_t dxax = globe_rotation * MAGIC_VALUE;
-
-	// Floor the 16.16 fp value
-	dxax &= ~0xffff;
-	// same as dxax &= 0xFFFFFFFFFFFF0000;
-
-	auto& first = globe_rotation_lookup_table[0];
-
-	assert_throw(first.unk0 == 0);
-	assert_throw(first.unk1 != 0);
-	first.fp_hi = hi(dxax);
-	first.fp_lo = lo(dxax);
-
-	// Add 0.5 in 16.16 fixed point
-	dxax += 0x8000;
-
-	// Convert back to value from 0-1 in 16.16 fixed point
-	uint16_t bx = dxax / MAGIC_VALUE;
-
-	for (int i = 1; i != MAX_TILT+1; ++i) {
-		auto& entry = globe_rotation_lookup_table[i];
-
-		assert_throw(entry.unk0 != 0); // meaning?
-		uint32_t dxax = 2 * uint32_t(bx) * uint32_t(entry.unk1);
-		entry.fp_hi = hi(dxax);
-		entry.fp_lo = lo(dxax);
-	}
-}
-
-inline 
-uint16_t clamp(int16_t value, int16_t min, int16_t max)
+std::array<uint8_t, 3> pal_color(int color_index)
 {
-	// with C++17: std::clamp
-	if (value < min) {
-		return min;
-	}
-	if (value > max) {
-		return max;
-	}
-	return value;
+	const uint8_t* triple = &globe_assets().pal[color_index * 3];
+	return { triple[0], triple[1], triple[2] };
 }
 
-void precalculate_globe_tilt_lookup_table(int16_t globe_tilt) {
-	globe_tilt = clamp(globe_tilt, -MAX_TILT, MAX_TILT);
-
-	int i = 0;
-
-	// For stage 1, count down from globe_tilt-(MAX_TILT+1) to -MAX_TILT
-	if (globe_tilt > 0) {
-		int v = globe_tilt - MAX_TILT;
-		do {
-			globe_tilt_lookup_table[i++] = uint8_t(--v);
-		} while (i != globe_tilt_lookup_table.size() && v > -MAX_TILT);
-	}
-
-	if (i == globe_tilt_lookup_table.size()) {
-		return;
-	}
-
-	// For stage 2, count down from MAX_TILT to 0
-	int v = globe_tilt + MAX_TILT - i;
-	do {
-		globe_tilt_lookup_table[i++] = uint8_t(v--);
-	} while (i != globe_tilt_lookup_table.size() && v >= 0);
-
-	if (i == globe_tilt_lookup_table.size()) {
-		return;
-	}
-
-	// For stage 3, count up from 1 to MAX_TILT, binary-or'ed with 0xff00
-	v = 1;
-	do {
-		globe_tilt_lookup_table[i++] = v++ | 0xff00;
-	} while (i != globe_tilt_lookup_table.size() && v <= MAX_TILT);
+using screen_colors_t = std::array<SDL_Color, 256>;
 
-	if (i == globe_tilt_lookup_table.size()) {
-		return;
+// PAL.BIN, darkened for the night
+screen_colors_t screen_colors(bool night)
+{
+	screen_colors_t colors{};
+	for (int i = 0; i != colors.size(); ++i) {
+		const auto color = pal_color(i);
+		colors[i].r = night ? color[0] / 3 : color[0];
+		colors[i].g = night ? color[1] / 3 : color[1];
+		colors[i].b = night ? color[2] / 2 : color[2];
 	}
-
-	// For stage 4, count up from -MAX_TILT to 0, binary-or'ed with 0xff00
-	v = -MAX_TILT;
-	do {
-		globe_tilt_lookup_table[i++] = v++ | 0xff00;
-	} while (i != globe_tilt_lookup_table.size() && v <= 0);
-}
-
-inline constexpr
-int frame_buffer_offset(int x, int y) {
-	return y * FRAMEBUFFER_WIDTH + x;
-}
-
-inline
-void draw_pixel(uint8_t* screen, uint32_t offset, uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha) {
-	screen[offset + 0] = red;
-	screen[offset + 1] = green;
-	screen[offset + 2] = blue;
-	screen[offset + 3] = alpha;
+	return colors;
 }
 
-// layout of GLOBDATA_BIN
-#pragma pack(push,1)
-struct table_values_t
-{
-	std::array<uint8_t, 99> value;
-	uint8_t unused; // forming the grey horizontal lines on the image with the two tables 
-};
-
-struct table_slices_t
-{
-	// in the parallel tables
-	table_values_t table0_slice; // left slice
-	table_values_t table1_slice; // right slice
-};
-
-struct GLOBDATA_BIN_t
+// the colors in the pixel format of the (32 bit) screen
+presenter_palette_t screen_palette(const SDL_PixelFormat* format, const screen_colors_t& colors)
 {
-	std::array<uint8_t, 3290> unk0;
-	std::array<table_slices_t, 64> all_slices;
-	uint8_t unused;
-};
-#pragma pack(pop)
-static_assert(sizeof(GLOBDATA_BIN_t) == sizeof(GLOBDATA_BIN),"wrong size");
-static_assert(offsetof(GLOBDATA_BIN_t, unk0) == 0, "wrong offset");
-static_assert(sizeof(GLOBDATA_BIN_t::unk0) == 3290, "wrong size");
-static_assert(offsetof(GLOBDATA_BIN_t, all_slices) == 3290,"wrong offset");
-static_assert(sizeof(GLOBDATA_BIN_t::all_slices) == 12800, "wrong size");
-
-struct result_t
-{
-	int16_t gd{};
-	int16_t grlt_0{};
-	uint16_t grlt_1{};
-	uint16_t entry_fp_hi{};
-};
-
-result_t func1(const table_slices_t& tables, const globe_rotation_lookup_table_t& rotation_lookup_table, const int16_t ofs1) {
-	const int8_t lo_ofs1 = lo(ofs1);
-	assert_throw((lo_ofs1 >= -98) && (lo_ofs1 <= 98));
+	assert_throw(format->BytesPerPixel == 4);
 
-	const int offset1 = (lo_ofs1 < 0) ? -lo_ofs1 : lo_ofs1;
-	assert_throw((offset1 >= 0) && (offset1 <= 98)); // 1,2,3,4,5,9,11,19,28,39,51,67,74,86,94,97,98
-
-	const uint8_t index_from_gd1 = tables.table0_slice.value[offset1];
-
-	//0,2,4,6,...,190,192,194,196 -> does not fit into int8_t
-	assert_throw((index_from_gd1 >= 0) && (index_from_gd1 <= 196) && ((index_from_gd1 % 2) == 0));
-
-	const auto& entry = rotation_lookup_table[index_from_gd1 / 2];
-	assert_throw((entry.unk0 >= 0) && (entry.unk0 <= 25334)); // signed: -25334 ... +25334
-	assert_throw((entry.unk1 >= 3) && (entry.unk1 <= 199));
-	assert_throw((entry.fp_hi >= 0) && (entry.fp_hi <= 397)); // 0,1,2,3,4,...,397
-
-	// ofs1 < 0 == hi & lo < 0?
-	const int16_t grlt_0 = (ofs1 < 0) ? -entry.unk0 : entry.unk0;
-	//with uint16_t
-	//assert((grlt_0 <= 65138) && ((grlt_0 % 2) == 0));
-	//with int16_t
-	assert_throw((grlt_0 >= -25334) && (grlt_0 <= 25334) && ((grlt_0 % 2) == 0));
-
-	const uint8_t index_from_gd2 = tables.table1_slice.value[offset1];
-	//accessors.access(&sub_globdata[MAGIC_200 / 2] - globdata_, 4);
-
-	//1,2,3,4,...,97,98,99 -> fits into int8_t
-	assert_throw(index_from_gd2 >= 0 && index_from_gd2 <= 99);
-
-	// (lo_ofs1 < 0) ? entry.unk1(3-199) - index_from_gd2(0..99) : index_from_gd2(0..99)
-	const int16_t gd = (lo_ofs1 < 0) ? entry.unk1 - index_from_gd2 : index_from_gd2;
-	assert_throw((gd >= 0) && (gd <= 195));
-
-	const uint16_t grlt_1 = entry.unk1 * 2;
-	assert_throw((grlt_1 >= 6) && (grlt_1 <= 398) && ((grlt_1 % 2) == 0));
-
-	return result_t{ gd, grlt_0, grlt_1, entry.fp_hi };
-};
-
-inline
-int color_map_offset(int16_t value, int16_t adjust1, int16_t adjust2) {
-	if (value < 0) {
-		value += adjust1;
-	}
-	value += adjust2;
-	return int(value);
-};
-
-uint8_t pixel_color(uint8_t value) {
-	//base color?
-	uint8_t color = value & 0x0f;
-
-	// this code is currently not in use
-	if ((value & 0x30) == 0x10) {
-		// overlay color?
-		if (color < 8) {
-			color += 12;
-		}
+	presenter_palette_t palette{};
+	for (int i = 0; i != palette.size(); ++i) {
+		palette[i] = SDL_MapRGB(const_cast<SDL_PixelFormat*>(format), colors[i].r, colors[i].g, colors[i].b);
 	}
+	return palette;
+}
 
-	color += 0x10;
-	return color;
-};
-
-void set_pixel_color(uint8_t* framebuffer_pixel, int map_ofs)
-{
-	constexpr int MAGIC_OFS1 = 0x62FC; // middle?
-	const uint8_t* sub_map = &MAP_BIN[MAGIC_OFS1];
-
-	assert_throw((map_ofs >= -25334) && (map_ofs <= 25339));
-
-	*framebuffer_pixel = pixel_color(sub_map[map_ofs]);
-};
-
-void func2(const table_slices_t& tables, const int8_t gd_val, const int left_side_globe_pixel_ofs, const int right_side_globe_pixel_ofs)
-{
-	// hi,lo int8 values?
-	const uint16_t some_value = globe_tilt_lookup_table[MAX_TILT + gd_val];
-	const result_t res = func1(tables, globe_rotation_lookup_table, some_value);
-
-	assert_throw((res.gd >= 0) && (res.gd <= 195));
-	assert_throw((res.grlt_0 >= -25334) && (res.grlt_0 <= 25334) && ((res.grlt_0 % 2) == 0));
-	assert_throw((res.grlt_1 >= 6) && (res.grlt_1 <= 398) && ((res.grlt_1 % 2) == 0));
-	assert_throw((res.entry_fp_hi >= 0) && (res.entry_fp_hi <= 397)); // 0,1,2,3,4,...,397
-
-	// left part of the globe
-	set_pixel_color(
-		&framebuffer[left_side_globe_pixel_ofs],
-		color_map_offset(res.entry_fp_hi - res.gd,
-			res.grlt_1,
-			res.grlt_0)
-	);
-
-	// right part of the globe
-	set_pixel_color(
-		&framebuffer[right_side_globe_pixel_ofs],
-		color_map_offset(res.entry_fp_hi + res.gd - res.grlt_1,
-			res.grlt_1,
-			res.grlt_0)
-	);
-};
-
-std::vector<std::vector<uint8_t>> parse_globe_lines(const std::array<uint8_t, 3290>& unk0)
+// whole_screen: also the static background, otherwise only the globe is converted and updated
+void present_frame(const uint8_t* frame_pixels, bool whole_screen)
 {
-#if 0
-// layout documentation
-#pragma pack(push,1)
-	struct unk0_t
-	{
-		int8_t first; // -65
-		std::array<int8_t, 2868> values; // n lines of (non negative)values ending with negative value (and a final -1 value)
-		// forming a globe contur
-		// v are indices to the globe_tilt_lookup_table
-			//v v v v v v [<0]
-			//v v v v v v v v v v v v [<0]
-			//v v v v v v v v v v v v v [<0]
-			//v v v v v v v v v v v v v v v [<0]
-			//v v v v v v v v v v v v v [<0]
-			//...
-			//v v v v v v v v v v [<0]
-			//-1
-		std::array<uint8_t, 421> unused; // all 0
-	};
-#pragma pack(pop)
-	static_assert(offsetof(unk0_t, unused) == 2869, "wrong offset");
-#endif
+	const framebuffer_rect_t& rect = whole_screen ? FRAMEBUFFER_RECT : globe_bounding_rect();
 
-	std::vector<std::vector<uint8_t>> lines;
-
-	int di = 1;
-
-	int8_t val0 = unk0[0];
-	assert(val0 == -65);
-
-	std::vector<uint8_t> values;
-	while (true)
-	{
-		assert_throw((di >= 1) && (di <= 2867));
-
-		int8_t val = unk0[di++];
-		if (val == -1)
-		{
-			break;
-		}
+	if (SDL_MUSTLOCK(screen)) SDL_LockSurface(screen);
 
-		do
-		{
-			assert_throw(val >= 0);
-			values.push_back(val);
-			val = unk0[di++];
-		} while (val >= 0);
-		lines.push_back(values);
-		values = {};
+	framebuffer_rect_t presented;
+	if (screen->format->BytesPerPixel == 1) {
+		presented = presenter.present_indexed(frame_pixels, resolution_factor, (uint8_t*)screen->pixels, screen->pitch, rect);
+	} else {
+		presented = presenter.present(frame_pixels, resolution_factor, (uint8_t*)screen->pixels, screen->pitch, rect);
 	}
 
-	assert_throw(di == 2868);
+	if (SDL_MUSTLOCK(screen)) SDL_UnlockSurface(screen);
 
-	for (int i = 2869; i < unk0.size(); ++i)
-	{
-		assert_throw(unk0[i] == 0);
+	if (whole_screen) {
+		SDL_Flip(screen);
+		return;
 	}
 
-	return lines;
+	SDL_Rect update_rect;
+	update_rect.x = Sint16(presented.x * resolution_factor);
+	update_rect.y = Sint16(presented.y * resolution_factor);
+	update_rect.w = Uint16(presented.w * resolution_factor);
+	update_rect.h = Uint16(presented.h * resolution_factor);
+	SDL_UpdateRects(screen, 1, &update_rect);
 }
 
-std::vector<std::vector<uint8_t>> GLOBE_LINES;
-
-struct point_t
-{
-	int x{};
-	int y{};
-};
-
-enum class hemisphere_t
-{
-	NORTH,
-	SOUTH
-};
-
-void draw_hemisphere(
-	hemisphere_t hemisphere,
-	const std::vector<std::vector<uint8_t>>& globe_lines,
-	const std::array<table_slices_t, 64>& all_slices
-	)
+// an 8-bit screen only needs the new palette, a 32 bit one is expanded again
+void set_screen_colors(const screen_colors_t& colors, const uint8_t* frame_pixels)
 {
-	const bool is_north = hemisphere == hemisphere_t::NORTH;
-
-	const int start_line = is_north ? 0 : 1;
-	const auto start_point = is_north ? point_t{ 160, 80-1 } : point_t{ 160, 80+0 };
-	const int framebuffer_line_inc = is_north ? -FRAMEBUFFER_WIDTH : FRAMEBUFFER_WIDTH;
-
-	const int GLOBE_CENTER_OFS = frame_buffer_offset(start_point.x, start_point.y);
-	int right_side_globe_pixel_ofs = GLOBE_CENTER_OFS;
-	int framebuffer_line_start = GLOBE_CENTER_OFS;
-	int left_side_globe_pixel_ofs = GLOBE_CENTER_OFS - 1;
-
-	for (int gl = start_line; gl < globe_lines.size(); ++gl)
-	{
-		const auto& line = globe_lines[gl];
-		for (int index = 0; index < line.size(); ++index)
-		{
-			const int8_t gd_val = line[index];
-			func2(
-				all_slices[index],
-				is_north ? gd_val : -gd_val,
-				left_side_globe_pixel_ofs--, right_side_globe_pixel_ofs++);
-		}
-
-		framebuffer_line_start += framebuffer_line_inc;
-		right_side_globe_pixel_ofs = framebuffer_line_start;
-		left_side_globe_pixel_ofs = framebuffer_line_start - 1;
-	}
-};
-
-void draw_globe(uint8_t* framebuffer) {
-	const GLOBDATA_BIN_t* globdata2 = reinterpret_cast<const GLOBDATA_BIN_t*>(GLOBDATA_BIN);
-
-	draw_hemisphere(hemisphere_t::NORTH, GLOBE_LINES, globdata2->all_slices);
-	draw_hemisphere(hemisphere_t::SOUTH, GLOBE_LINES, globdata2->all_slices);
-}
-
-void init_globe_rotation_lookup_table() {
-	const rotation_lookup_table_entry_t* tablat_entries = reinterpret_cast<const rotation_lookup_table_entry_t*>(&TABLAT_BIN);
-
-	for (int i = 0; i != globe_rotation_lookup_table.size(); i++) {
-		globe_rotation_lookup_table[i] = tablat_entries[i];
+	if (screen->format->BytesPerPixel == 1) {
+		SDL_SetColors(screen, const_cast<SDL_Color*>(colors.data()), 0, int(colors.size()));
+		return;
 	}
-}
-
-// to show that the table data is not changing over the time
-#define ALWAYS_INIT() (true)
-
-struct draw_params_t {
-	int16_t  tilt{};
-	uint16_t rotation{};
-};
-
-struct rgb_t
-{
-	uint8_t r{};
-	uint8_t g{};
-	uint8_t b{};
-};
 
-inline
-std::array<uint8_t, 3> pal_color(int color_index)
-{
-	const uint8_t* triple = &PAL_BIN[color_index * 3];
-	return { triple[0], triple[1], triple[2] };
+	presenter.set_palette(screen_palette(screen->format, colors));
+	present_frame(frame_pixels, true);
 }
 
 #define COMPARE_WITH_INITAL_CODE() (true)
@@ -476,86 +130,98 @@ namespace initial_port
 }
 
 std::array<uint8_t, FRAMEBUFFER_WIDTH* FRAMEBUFFER_HEIGHT> test_framebuffer{};
-#endif
-
-#define DO_DRAW() (true)
 
-void draw_frame(void *draw_params) {
-#if DO_DRAW()
-	if (SDL_MUSTLOCK(screen)) SDL_LockSurface(screen);
+// set: sampled verification, the reference runs on its thread only
+std::unique_ptr<shadow_verifier_t> shadow_verifier;
 #endif
 
-	auto& dp = *reinterpret_cast<draw_params_t*>(draw_params);
-	const int16_t  tilt     = dp.tilt;
-	const uint16_t rotation = dp.rotation;
-
-#if ALWAYS_INIT()
-	init_globe_rotation_lookup_table();
-#endif
-	precalculate_globe_rotation_lookup_table(rotation);
+#define DO_DRAW() (true)
 
-#if 0
-	for (int i = 0; i < globe_rotation_lookup_table.size(); ++i)
-	{
-		printf("[%02i] %u\n", i, globe_rotation_lookup_table[i]);
+// generation: globe_assets().generation the frame was drawn with
+void compare_with_initial_code(const uint8_t* frame_pixels, int16_t tilt, uint16_t rotation, unsigned generation)
+{
+#if COMPARE_WITH_INITAL_CODE()
+	// drawn before the assets were reloaded, the reference would draw the new ones
+	if (generation != globe_assets().generation) {
+		return;
 	}
-#endif
-
-	precalculate_globe_tilt_lookup_table(tilt);
 
-	draw_globe(framebuffer.data());
+	if (shadow_verifier) {
+		shadow_verifier->submit(tilt, rotation, frame_pixels);
+		return;
+	}
 
-#if COMPARE_WITH_INITAL_CODE()
 	initial_port::draw_frame(tilt, rotation, test_framebuffer.data());
-	if (framebuffer != test_framebuffer)
+	if (memcmp(frame_pixels, test_framebuffer.data(), test_framebuffer.size()) != 0)
 	{
 		assert(false);
 		printf("framebuffer != test_framebuffer rotation=%u, tilt=%i\n", rotation, tilt);
 		throw 0xdeadbeef;
 	}
 #endif
+}
 
-#if DO_DRAW()
-	uint8_t *screenbuffer = (uint8_t*)screen->pixels;
+// true: the pose was presented, false: the screen already showed it
+bool draw_pose(int16_t tilt, uint16_t rotation)
+{
+	// false: same canonical pose as the last frame, the screen is up to date
+	const bool changed = renderer.render(tilt, rotation, framebuffer.data());
 
-	for (int i = 0; i != framebuffer.size(); ++i) {
-		int color_index = framebuffer[i];
+	compare_with_initial_code(framebuffer.data(), tilt, rotation, renderer.assets_generation());
 
-		const auto color = pal_color(color_index);
+#if DO_DRAW()
+	if (!changed) {
+		return false;
+	}
 
-#ifdef _WIN32
-		const rgb_t rgb{ color[2], color[1], color[0]};
-#else
-		const rgb_t rgb{ color[0], color[1], color[2] };
+	present_frame(framebuffer.data(), false);
 #endif
+	return changed;
+}
 
-#if 1
-		unsigned x = i / FRAMEBUFFER_WIDTH;
-		unsigned y = i % FRAMEBUFFER_WIDTH;
-		for (unsigned w = 0; w < resolution_factor; ++w) {
-			for (unsigned h = 0; h < resolution_factor; ++h) {
-				const unsigned pixel_offset = ((x * resolution_factor + w)
-					                           * (FRAMEBUFFER_WIDTH * resolution_factor)
-					                           + (y * resolution_factor + h)) * 4;
-				draw_pixel(screenbuffer, pixel_offset, rgb.r, rgb.g, rgb.b, 255);
-			}
-		}
-#else
-		const unsigned pixel_offset = 4 * i;
-        draw_pixel(screenbuffer, pixel_offset, rgb.r, rgb.g, rgb.b, 255);
-#endif
+void draw_frame(void *draw_params) {
+	auto& dp = *reinterpret_cast<draw_params_t*>(draw_params);
+	draw_pose(dp.tilt, dp.rotation);
+}
+
+// the pipelined counterpart of draw_pose: presents the newest frame the render thread
+// finished, if there is one
+bool present_pipelined_frame(globe_pipeline_t& pipeline, globe_pipeline_t::frame_t& frame)
+{
+	if (!pipeline.acquire(frame)) {
+		return false;
 	}
 
-	if (SDL_MUSTLOCK(screen)) SDL_UnlockSurface(screen);
+	compare_with_initial_code(frame.pixels, frame.tilt, frame.rotation, frame.generation);
 
-	SDL_Flip(screen);
+#if DO_DRAW()
+	present_frame(frame.pixels, false);
 #endif
+	return true;
 }
 
-struct pos_t {
-	int16_t tilt{};
-	int16_t rotation{};
-};
+#ifndef __EMSCRIPTEN__
+// the idle loop still wakes up this often without events
+constexpr Uint32 IDLE_WAKEUP_MS = 500;
+
+Uint32 push_wakeup_event(Uint32, void*)
+{
+	SDL_Event event{};
+	event.type = SDL_USEREVENT;
+	SDL_PushEvent(&event);
+	return 0;
+}
+
+// SDL 1.2 has no SDL_WaitEventTimeout, a one shot timer pushes an SDL_USEREVENT instead.
+// false: timed out
+bool wait_event(SDL_Event& event, Uint32 timeout_ms)
+{
+	SDL_TimerID timer = SDL_AddTimer(timeout_ms, push_wakeup_event, nullptr);
+	const int got_event = SDL_WaitEvent(&event);
+	SDL_RemoveTimer(timer);
+	return got_event && event.type != SDL_USEREVENT;
+}
+#endif
 
 struct animated_t {
 	int frame{0};
@@ -571,69 +237,93 @@ struct animated_t {
 	}
 };
 
+// every canonical pose once: 197 x 398 frames instead of 197 x 65536
 struct complete_t {
-	int16_t tilt = -97;
-	uint16_t rotation = 0;
+	int pose_index = 0;
 
 	bool stop = false;
 
 	pos_t next() {
-		//printf("rotation: %i, %u\n", rotation, uint16_t(rotation)); uses full range of 0-65535 for a full rotation
-		//printf("tilt: %i\n", tilt);
-
-		if (tilt < 97)
+		if (pose_index == GLOBE_POSE_COUNT)
 		{
-			if (rotation < std::numeric_limits<uint16_t>::max())
-			{
-				//printf("rotation: %u\n", rotation);
-				++rotation;
-			}
-			else
-			{
-				printf("new tilt: %i\n", tilt);
-				++tilt;
-				rotation = 0;
-			}
+			stop = true;
+			return {};
 		}
-		else
+
+		const globe_pose_t pose = globe_pose_from_index(pose_index++);
+		if (pose.rotation_class == 0)
 		{
-			stop = true;
+			printf("new tilt: %i\n", globe_pose_tilt(pose));
 		}
 
-		return { tilt, (int16_t)rotation };
+		return { globe_pose_tilt(pose), (int16_t)globe_pose_rotation(pose) };
 	}
 };
 
 extern "C"
 int main() {
-	SDL_Init(SDL_INIT_VIDEO);
-
-	const GLOBDATA_BIN_t* globdata2 = reinterpret_cast<const GLOBDATA_BIN_t*>(GLOBDATA_BIN);
-	GLOBE_LINES = parse_globe_lines(globdata2->unk0);
+	SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER);
 
 #if 0
 	FILE* fp{};
 	fopen_s(&fp, "d:/temp/globel_lines_size.csv", "w+");
-	for (auto& gl : GLOBE_LINES)
+	for (auto& row : renderer.program().rows)
 	{
-		fprintf(fp, "%u\n", gl.size());
+		fprintf(fp, "%u\n", row.count);
 	}
 	fclose(fp);
 #endif
 
-#if !ALWAYS_INIT()
-	init_globe_rotation_lookup_table();
-#endif
+	if (paletted_screen) {
+		screen = SDL_SetVideoMode(FRAMEBUFFER_WIDTH*resolution_factor, FRAMEBUFFER_HEIGHT*resolution_factor, 8, SDL_SWSURFACE | SDL_HWPALETTE);
+	} else {
+		screen = SDL_SetVideoMode(FRAMEBUFFER_WIDTH*resolution_factor, FRAMEBUFFER_HEIGHT*resolution_factor, 32, SDL_SWSURFACE);
+	}
+	const globe_embedded_assets_t& embedded_assets = globe_embedded_assets();
+	if (embedded_assets.stored_size != embedded_assets.size) {
+		printf("assets: %zu bytes unpacked from %zu in %.2f ms\n", embedded_assets.size, embedded_assets.stored_size, embedded_assets.decode_ms);
+	}
+
+	if (asset_directory) {
+		// false: the embedded assets stay, the reason is on stderr
+		load_globe_assets(asset_directory);
+	}
 
-	screen = SDL_SetVideoMode(FRAMEBUFFER_WIDTH*resolution_factor, FRAMEBUFFER_HEIGHT*resolution_factor, 32, SDL_SWSURFACE);
+	bool night = false;
+	set_screen_colors(screen_colors(night), framebuffer.data());
+	// the background outside of the globe never changes, it is only drawn here
+	present_frame(framebuffer.data(), true);
 
 #ifdef TEST_SDL_LOCK_OPTS
 	EM_ASM("SDL.defaults.copyOnLock = false; SDL.defaults.discardOnLock = true; SDL.defaults.opaqueFrontBuffer = false;");
 #endif
 
 #ifdef __EMSCRIPTEN__
-	emscripten_set_main_loop_arg(draw_frame, NULL, -1, 1);
+	static draw_params_t dp{};
+	emscripten_set_main_loop_arg(draw_frame, &dp, -1, 1);
 #else
+	renderer.set_thread_count(render_thread_count);
+	renderer.set_frame_cache_budget(frame_cache_budget);
+	// the pipeline's renderer draws on another thread, its pick buffer changes under pick()
+	renderer.set_picking(show_map_cell && !pipelined_rendering);
+
+#if COMPARE_WITH_INITAL_CODE()
+	if (shadow_sample_interval > 0) {
+		shadow_verifier = std::make_unique<shadow_verifier_t>(initial_port::draw_frame, shadow_sample_interval);
+	}
+#endif
+
+	// owns the renderer from here on, if enabled
+	std::unique_ptr<globe_pipeline_t> pipeline;
+	if (pipelined_rendering) {
+		pipeline = std::make_unique<globe_pipeline_t>(renderer);
+	}
+	// the frame on screen, for redrawing it after a palette change
+	const uint8_t* presented_pixels = framebuffer.data();
+
+	frame_scheduler_t scheduler;
+	scheduler.set_target_fps(target_fps);
+
 	bool run = true;
 
 	bool is_animated = false;
@@ -642,12 +332,79 @@ int main() {
 
 	pos_t cursor_based;
 
+	// framebuffer pixel under the mouse
+	int mouse_x = -1;
+	int mouse_y = -1;
+	auto update_map_cell_caption = [&]() {
+		if (!renderer.picking()) {
+			return;
+		}
+		const globe_pick_t cell = renderer.pick(mouse_x, mouse_y);
+		char caption[64] = "";
+		if (cell.on_globe) {
+			snprintf(caption, sizeof(caption), "MAP.BIN 0x%04x (%02x): ring %u column %u",
+				cell.map_index, globe_assets().map[cell.map_index], cell.ring, cell.column);
+		}
+		SDL_WM_SetCaption(caption, nullptr);
+	};
+
+	auto handle_event = [&](const SDL_Event& event) {
+		if (event.type == SDL_QUIT) {
+			run = false;
+			return;
+		}
+		if (event.type == SDL_MOUSEMOTION) {
+			mouse_x = event.motion.x / int(resolution_factor);
+			mouse_y = event.motion.y / int(resolution_factor);
+			update_map_cell_caption();
+		}
+		if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
+			scheduler.input_event();
+		}
+		if (event.type == SDL_KEYDOWN) {
+			//Set the proper message surface
+			switch (event.key.keysym.sym) {
+				case SDLK_a:
+					is_animated = !is_animated;
+					break;
+				case SDLK_n: {
+					const auto input = frame_scheduler_t::clock::now();
+					night = !night;
+					set_screen_colors(screen_colors(night), presented_pixels);
+					scheduler.input_presented(input);
+					break;
+				}
+				case SDLK_r:
+					// e.g. a different MAP.BIN, the renderer notices and drops its cached frames.
+					// The queued shadow samples were drawn from the old assets and the reference
+					// reads them on the verifier thread, so they are verified first.
+#if COMPARE_WITH_INITAL_CODE()
+					if (shadow_verifier) {
+						shadow_verifier->flush();
+					}
+#endif
+					if (asset_directory && load_globe_assets(asset_directory)) {
+						set_screen_colors(screen_colors(night), presented_pixels);
+						scheduler.redraw();
+					}
+					break;
+			}
+		}
+	};
+
 	while (run) {
+		// sample the input as late as possible, right before the frame starts
+		scheduler.wait_for_frame_slot();
+
 		SDL_PumpEvents();
 		Uint8* keystate = SDL_GetKeyState(NULL);
 
 		constexpr int16_t ROTATION_STEP = 100;
 
+		const pos_t previous_cursor = cursor_based;
+		// a held key sends no events (no key repeat), the loop has to keep polling
+		const bool keys_held = keystate[SDLK_LEFT] || keystate[SDLK_RIGHT] || keystate[SDLK_UP] || keystate[SDLK_DOWN];
+
 		//continuous-response keys
 		if (keystate[SDLK_LEFT]) {
 			cursor_based.rotation += ROTATION_STEP;
@@ -663,19 +420,11 @@ int main() {
 		}
 
 		SDL_Event event;
-		while (SDL_PollEvent(&event)) {  // poll until all events are handled!
-			if (event.type == SDL_QUIT) {
-				run = false;
-				break;
-			}
-			if (event.type == SDL_KEYDOWN) {
-				//Set the proper message surface
-				switch (event.key.keysym.sym) {
-					case SDLK_a:
-						is_animated = !is_animated;
-						break;
-				}
-			}
+		while (run && SDL_PollEvent(&event)) {  // poll until all events are handled!
+			handle_event(event);
+		}
+		if (!run) {
+			break;
 		}
 
 		if (is_animated) {
@@ -692,13 +441,85 @@ int main() {
 		}
 #endif
 
-		draw_params_t dp{ cursor_based.tilt , cursor_based.rotation };
-		draw_frame(&dp);
+		const bool input_moved = keys_held || cursor_based.tilt != previous_cursor.tilt || cursor_based.rotation != previous_cursor.rotation;
+
+		const globe_pose_t pose = canonical_globe_pose(cursor_based.tilt, cursor_based.rotation);
+		const bool needs_frame = scheduler.needs_frame(pose, is_animated);
+
+		if (pipeline) {
+			if (needs_frame) {
+				pipeline->request(cursor_based.tilt, cursor_based.rotation, scheduler.issue_frame());
+			}
+
+			globe_pipeline_t::frame_t frame;
+			bool presented = present_pipelined_frame(*pipeline, frame);
+			// paced: this slot is for presenting, wait for the render thread instead of skipping it
+			while (!presented && scheduler.target_fps() != 0 && !pipeline->idle()) {
+				SDL_Delay(1);
+				presented = present_pipelined_frame(*pipeline, frame);
+			}
+			if (presented) {
+				presented_pixels = frame.pixels;
+				scheduler.frame_presented(frame.sequence);
+				continue;
+			}
+			if (needs_frame || !pipeline->idle()) {
+				// the render thread is busy, don't spin on its core
+				SDL_Delay(1);
+				continue;
+			}
+		} else if (needs_frame) {
+			const uint64_t sequence = scheduler.issue_frame();
+			if (draw_pose(cursor_based.tilt, cursor_based.rotation)) {
+				scheduler.frame_presented(sequence);
+				update_map_cell_caption();
+			}
 #if 0 // just one frame
-		return 0;
+			return 0;
+#endif
+			continue;
+		}
+
+		// a rotation step is smaller than a rotation class, the pose can stay for a few
+		// passes while a key is held: wait for the next slot, not for the next event
+		if (input_moved) {
+			if (scheduler.target_fps() == 0) {
+				SDL_Delay(1);
+			}
+			continue;
+		}
+
+		// nothing to draw until the next event
+		scheduler.going_idle();
+		if (wait_event(event, IDLE_WAKEUP_MS)) {
+			handle_event(event);
+		}
+	}
+
+#if COMPARE_WITH_INITAL_CODE()
+	if (shadow_verifier) {
+		shadow_verifier->flush();
+		const shadow_verifier_t::stats_t stats = shadow_verifier->stats();
+		printf("shadow verification: %llu of %llu frames sampled, %llu verified, %llu mismatches, %llu dropped\n",
+			(unsigned long long)stats.sampled, (unsigned long long)stats.frames, (unsigned long long)stats.verified,
+			(unsigned long long)stats.mismatches, (unsigned long long)stats.dropped);
+		shadow_verifier.reset();
+	}
 #endif
 
-		//SDL_Delay(10);
+	const frame_scheduler_t::stats_t& scheduler_stats = scheduler.stats();
+	const frame_scheduler_t::latency_t latency = scheduler.latency();
+	printf("scheduler: %llu frames, %llu idle waits, %llu late frames, input latency p50 %.2f ms, p99 %.2f ms, max %.2f ms (%zu samples)\n",
+		(unsigned long long)scheduler_stats.frames, (unsigned long long)scheduler_stats.idle_waits,
+		(unsigned long long)scheduler_stats.late_frames, latency.p50_ms, latency.p99_ms, latency.max_ms,
+		latency.samples);
+
+	if (pipeline) {
+		const globe_pipeline_t::stats_t stats = pipeline->stats();
+		printf("pipeline: %llu requests, %llu superseded, %llu rendered, %llu presented, %llu dropped\n",
+			(unsigned long long)stats.requests, (unsigned long long)stats.superseded,
+			(unsigned long long)stats.rendered, (unsigned long long)stats.acquired,
+			(unsigned long long)stats.dropped);
 	}
 #endif
 	SDL_Quit();
@@ -0,0 +1,116 @@
+#include "shadow_verifier.h"
+
+#include <cstdio>
+#include <cstring>
+
+shadow_verifier_t::shadow_verifier_t(reference_t reference, unsigned sample_interval, size_t queue_limit)
+	: reference(reference)
+	, sample_interval(sample_interval ? sample_interval : 1)
+	, queue_limit(queue_limit)
+{
+	thread = std::thread(&shadow_verifier_t::verifier_main, this);
+}
+
+shadow_verifier_t::~shadow_verifier_t()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	wake.notify_one();
+
+	thread.join();
+}
+
+uint64_t shadow_verifier_t::hash_globe_pixels(const uint8_t* framebuffer)
+{
+	const framebuffer_rect_t& rect = globe_bounding_rect();
+
+	// FNV-1a over 8 byte words, the rect rows are 128 pixels wide
+	uint64_t h = 0xcbf29ce484222325ull;
+	for (int y = rect.y; y < rect.y + rect.h; ++y) {
+		const uint8_t* row = &framebuffer[y * FRAMEBUFFER_WIDTH + rect.x];
+		int x = 0;
+		for (; x + 8 <= rect.w; x += 8) {
+			uint64_t word;
+			memcpy(&word, row + x, 8);
+			h = (h ^ word) * 0x100000001b3ull;
+			h ^= h >> 32;
+		}
+		for (; x < rect.w; ++x) {
+			h = (h ^ row[x]) * 0x100000001b3ull;
+		}
+	}
+	return h;
+}
+
+void shadow_verifier_t::submit(int16_t tilt, uint16_t rotation, const uint8_t* framebuffer)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (counters.frames++ % sample_interval != 0) {
+			return;
+		}
+		++counters.sampled;
+		if (queue.size() >= queue_limit) {
+			++counters.dropped;
+			return;
+		}
+	}
+
+	// outside of the lock, this is the part the caller pays for
+	const sample_t sample{ tilt, rotation, hash_globe_pixels(framebuffer) };
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back(sample);
+	}
+	wake.notify_one();
+}
+
+void shadow_verifier_t::flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return queue.empty() && !verifying; });
+}
+
+shadow_verifier_t::stats_t shadow_verifier_t::stats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return counters;
+}
+
+void shadow_verifier_t::verifier_main()
+{
+	std::vector<uint8_t> framebuffer(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT);
+
+	while (true) {
+		sample_t sample;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stop || !queue.empty(); });
+			if (stop) {
+				return;
+			}
+			sample = queue.front();
+			queue.pop_front();
+			verifying = true;
+		}
+
+		memset(framebuffer.data(), 0, framebuffer.size());
+		reference(sample.tilt, int16_t(sample.rotation), framebuffer.data());
+		const bool match = hash_globe_pixels(framebuffer.data()) == sample.hash;
+
+		if (!match) {
+			fprintf(stderr, "shadow verification: tilt=%i rotation=%u differs from the reference\n", sample.tilt, sample.rotation);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			++counters.verified;
+			counters.mismatches += !match;
+			verifying = false;
+		}
+		idle.notify_all();
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "globe_renderer.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ *  Checks every Nth rendered frame against a reference renderer on a background thread.
+ *  The caller only hashes the globe pixels of a sampled frame and queues pose and hash,
+ *  it never waits for the reference. A full queue drops the sample, a mismatch is logged
+ *  and counted, nothing is thrown.
+ */
+class shadow_verifier_t
+{
+public:
+	// draws the pose into a framebuffer that was cleared to 0, e.g. initial_port::draw_frame
+	using reference_t = void (*)(int16_t tilt, int16_t rotation, uint8_t* framebuffer);
+
+	struct stats_t
+	{
+		uint64_t frames;     // submit() calls
+		uint64_t sampled;
+		uint64_t verified;
+		uint64_t mismatches;
+		uint64_t dropped;    // samples that found the queue full
+	};
+
+	// sample_interval: 1 checks every frame, 60 every 60th
+	shadow_verifier_t(reference_t reference, unsigned sample_interval, size_t queue_limit = 16);
+	~shadow_verifier_t();
+
+	shadow_verifier_t(const shadow_verifier_t&) = delete;
+	shadow_verifier_t& operator=(const shadow_verifier_t&) = delete;
+
+	// framebuffer: the rendered frame of the pose, only read during the call
+	void submit(int16_t tilt, uint16_t rotation, const uint8_t* framebuffer);
+
+	// waits until every queued sample is verified, e.g. before the assets the reference reads change
+	void flush();
+
+	stats_t stats() const;
+
+	// hash of the pixels inside globe_bounding_rect(), the only ones a frame changes
+	static uint64_t hash_globe_pixels(const uint8_t* framebuffer);
+
+private:
+	void verifier_main();
+
+	struct sample_t
+	{
+		int16_t tilt;
+		uint16_t rotation;
+		uint64_t hash;
+	};
+
+	const reference_t reference;
+	const unsigned sample_interval;
+	const size_t queue_limit;
+
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	std::deque<sample_t> queue;
+	bool verifying = false;
+	bool stop = false;
+	stats_t counters{};
+
+	std::thread thread;
+};
@@ -0,0 +1,99 @@
+#include "worker_pool.h"
+
+worker_pool_t::worker_pool_t(unsigned thread_count)
+{
+	for (unsigned i = 1; i < thread_count; ++i) {
+		threads.emplace_back(&worker_pool_t::worker_main, this);
+	}
+}
+
+worker_pool_t::~worker_pool_t()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	wake.notify_all();
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+void worker_pool_t::do_jobs()
+{
+	try {
+		for (int i = next_job++; i < current_job_count; i = next_job++) {
+			(*current_job)(i);
+		}
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!error) {
+			error = std::current_exception();
+		}
+		// let the other threads run dry
+		next_job = current_job_count;
+	}
+}
+
+void worker_pool_t::worker_main()
+{
+	uint64_t seen_generation = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return stop || generation != seen_generation; });
+			if (stop) {
+				return;
+			}
+			seen_generation = generation;
+		}
+
+		do_jobs();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			++finished_workers;
+		}
+		done.notify_one();
+	}
+}
+
+void worker_pool_t::run(int job_count, const std::function<void(int)>& job)
+{
+	if (threads.empty() || job_count <= 1) {
+		for (int i = 0; i < job_count; ++i) {
+			job(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		current_job = &job;
+		current_job_count = job_count;
+		next_job = 0;
+		finished_workers = 0;
+		error = nullptr;
+		++generation;
+	}
+	wake.notify_all();
+
+	do_jobs();
+
+	// every worker has to check in, otherwise a late one could pick up
+	// the job of the next run with this run's (dead) job function
+	std::exception_ptr run_error;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [&] { return finished_workers == threads.size(); });
+		current_job = nullptr;
+		run_error = error;
+	}
+
+	if (run_error) {
+		std::rethrow_exception(run_error);
+	}
+}
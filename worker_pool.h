@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ *  Persistent pool of worker threads, the threads are created once and
+ *  sleep between runs (no thread creation per frame).
+ *  thread_count includes the calling thread, so 0 or 1 means everything
+ *  runs on the caller.
+ */
+class worker_pool_t
+{
+public:
+	explicit worker_pool_t(unsigned thread_count);
+	~worker_pool_t();
+
+	worker_pool_t(const worker_pool_t&) = delete;
+	worker_pool_t& operator=(const worker_pool_t&) = delete;
+
+	unsigned thread_count() const { return unsigned(threads.size()) + 1; }
+
+	// calls job(i) for every i in [0, job_count), jobs are handed out in order
+	// to whichever thread is free next. Returns when all jobs are done, an
+	// exception thrown by a job is rethrown here.
+	void run(int job_count, const std::function<void(int)>& job);
+
+private:
+	void worker_main();
+	void do_jobs();
+
+	std::vector<std::thread> threads;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	const std::function<void(int)>* current_job = nullptr;
+	int current_job_count = 0;
+	std::atomic<int> next_job{ 0 };
+	uint64_t generation = 0;
+	unsigned finished_workers = 0;
+	std::exception_ptr error;
+	bool stop = false;
+};